@@ -32,8 +32,35 @@ static void ThreeDOUpdate(void);
 static char ThreeDOChanged(char id);
 static char ThreeDOBuildReport(unsigned char *reportBuffer, char id);
 
-static unsigned int last_update_state=0;
-static unsigned int last_reported_state=0;
+/* Pads are daisy-chained: each one shifts out its own packet and then
+ * passes through the stream of the next pad, until the end of the chain
+ * where only zeros are read. Every device found on the chain gets its own
+ * report ID (1 to THREEDO_MAX_DEVICES).
+ */
+#define THREEDO_MAX_DEVICES		4
+#define THREEDO_MAX_PACKET		9	// Flightstick is the longest packet
+
+#define THREEDO_NONE			0
+#define THREEDO_JOYPAD			1
+#define THREEDO_FLIGHTSTICK		2
+#define THREEDO_MOUSE			3
+
+/* Packet sizes in bytes, indexed by device type. Only the ID header is
+ * used to pick the length, so a plain joypad is still a 16 bits read.
+ */
+static const unsigned char packet_size[] = { 0, 2, 9, 4 };
+
+/* Mice on the chain are merged into a single relative mouse report */
+#define THREEDO_MOUSE_REPORT	(THREEDO_MAX_DEVICES+1)
+
+static unsigned char device_type[THREEDO_MAX_DEVICES];
+static unsigned char last_update_state[THREEDO_MAX_DEVICES][THREEDO_MAX_PACKET];
+static unsigned char last_reported_type[THREEDO_MAX_DEVICES];
+static unsigned char last_reported_state[THREEDO_MAX_DEVICES][THREEDO_MAX_PACKET];
+
+static int mouse_dx=0, mouse_dy=0;
+static unsigned char mouse_buttons=0;
+static unsigned char last_reported_mouse_buttons=0;
 
 static char ThreeDOInit(void)
 {
@@ -61,37 +88,124 @@ static char ThreeDOInit(void)
 	DDRD |= (1<<PD7);
 	PORTD &= ~(1<<PD7); 
 
+	memset(device_type, THREEDO_NONE, sizeof(device_type));
+	memset(last_update_state, 0, sizeof(last_update_state));
+	memset(last_reported_type, THREEDO_NONE, sizeof(last_reported_type));
+	memset(last_reported_state, 0, sizeof(last_reported_state));
+
+	mouse_dx = mouse_dy = 0;
+	mouse_buttons = last_reported_mouse_buttons = 0;
+
 	return 0;
 }
 
+/* Shift in the next 8 bits of the stream, MSB first. The current bit is
+ * already on DATA when called, the pad shifts on each falling edge of CLK.
+ */
+static unsigned char ThreeDOReadByte(void)
+{
+	unsigned char i, b = 0;
+
+	for(i=0;i<8;i++)
+	{
+		b <<= 1;
+		if (PINC&(1<<PC2)) b |= 1;
+		PORTB &= ~(1<<PB5); //CLK=0
+		_delay_us(10);
+		PORTB |= (1<<PB5); //CLK=1
+		_delay_us(10);
+	}
+
+	return b;
+}
+
+static unsigned char ThreeDODeviceType(unsigned char id)
+{
+	/* Joypads start with 100, other devices send an ID byte */
+	if ((id&0xE0) == 0x80) return THREEDO_JOYPAD;
+	if (id == 0x01) return THREEDO_FLIGHTSTICK;
+	if (id == 0x49) return THREEDO_MOUSE;
+
+	/* End of chain (all zeros) or a device we do not know the length of */
+	return THREEDO_NONE;
+}
+
+/* Sign extend a 10 bits two's complement value */
+static int ThreeDOSigned10(unsigned int v)
+{
+	return (v&0x200) ? (int)(v|0xFC00) : (int)v;
+}
+
+/* Add the relative motion of a mouse packet to the pending deltas. The
+ * packet is then cleared so its slot only reports plug/unplug events.
+ */
+static void ThreeDOAccumulateMouse(unsigned char *pkt)
+{
+	// Packet buttons MSB first: LEFT MIDDLE RIGHT SHIFT, report: SHIFT MIDDLE RIGHT LEFT
+	mouse_buttons |= ((pkt[1]>>7)&0x01)|((pkt[1]>>4)&0x02)|((pkt[1]>>4)&0x04)|((pkt[1]>>1)&0x08);
+	mouse_dy += ThreeDOSigned10(((pkt[1]&0x0F)<<6)|(pkt[2]>>2));
+	mouse_dx += ThreeDOSigned10(((pkt[2]&0x03)<<8)|pkt[3]);
+
+	memset(pkt+1, 0, THREEDO_MAX_PACKET-1);
+}
+
 static void ThreeDOUpdate(void)
 {
-	unsigned char button;
+	unsigned char dev, i, type;
 
 	/* Reset clock 50us Up 50us Down */
 	PORTB |= (1<<PB5); //CLK=1
 	_delay_us(50);
 	PORTB &= ~(1<<PB5); //CLK=0
 	_delay_us(50);
-	
-	last_update_state = 0x0000;
-	/* last_update_state format:
+
+	/* Joypad packet format (2 bytes, MSB first):
 	 * 
-	 * 15 14 13 12 11 10 9 8 7 6 5    4     3  2    1 0
-	 * 1  0  0  L  R  X  P C B A LEFT RIGHT UP DOWN 0 0
+	 *   7 6 5 4    3  2     1    0
+	 *   1 0 0 DOWN UP RIGHT LEFT A
+	 *   B C P X    R  L     0    0
 	 */
 
 	PORTB |= (1<<PB5); //CLK=1
 	_delay_us(10);	
 	PORTB &= ~(1<<PB4); //P/S=0
+	_delay_us(10);
+
+	/* Flightstick packet format (9 bytes, MSB first):
+	 *
+	 *   0x01 0x7B 0x08 (ID)
+	 *   X (10 bits) Y (10 bits) THROTTLE (10 bits) 0 0
+	 *   FIRE A B C UP DOWN RIGHT LEFT
+	 *   P X L R 0 0 0 0
+	 *
+	 * Mouse packet format (4 bytes, MSB first):
+	 *
+	 *   0x49 (ID)
+	 *   LEFT MIDDLE RIGHT SHIFT DY (10 bits) DX (10 bits)
+	 */
 
-	for(button=0;button<15;button++)
+	mouse_buttons = 0;
+
+	type = THREEDO_JOYPAD;
+	for(dev=0;dev<THREEDO_MAX_DEVICES;dev++)
 	{
-		PORTB &= ~(1<<PB5); //CLK=0
-		_delay_us(10);
-		last_update_state |= (((PINC&(1<<PC2))?1:0)<<(button));
-		PORTB |= (1<<PB5); //CLK=1
-		_delay_us(10);
+		if (type != THREEDO_NONE)
+		{
+			last_update_state[dev][0] = ThreeDOReadByte();
+			type = ThreeDODeviceType(last_update_state[dev][0]);
+
+			for(i=1;i<packet_size[type];i++)
+				last_update_state[dev][i] = ThreeDOReadByte();
+		}
+
+		/* Nothing more on the chain, clear the remaining slots */
+		if (type == THREEDO_NONE)
+			memset(last_update_state[dev], 0, THREEDO_MAX_PACKET);
+
+		if (type == THREEDO_MOUSE)
+			ThreeDOAccumulateMouse(last_update_state[dev]);
+
+		device_type[dev] = type;
 	}
 
 	PORTB |= (1<<PB4); //P/S=1
@@ -99,45 +213,124 @@ static void ThreeDOUpdate(void)
 
 static char ThreeDOChanged(char id)
 {
-	return (last_update_state != last_reported_state);
+	unsigned char dev = id-1;
+
+	if (!id || id > THREEDO_MOUSE_REPORT)
+		return 0;	// Report ID from the host, not one of ours
+	if (id == THREEDO_MOUSE_REPORT)
+		return (mouse_dx || mouse_dy || mouse_buttons != last_reported_mouse_buttons);
+
+	if (device_type[dev] != last_reported_type[dev])
+		return 1;
+
+	return memcmp(last_update_state[dev], last_reported_state[dev], packet_size[device_type[dev]]) != 0;
+}
+
+#define REPORT_SIZE			7
+#define MOUSE_REPORT_SIZE	6
+
+/* Clip a pending mouse delta to what fits in the report, the remainder is
+ * kept for the next report so no motion is lost.
+ */
+static int ThreeDOTakeDelta(int *acc)
+{
+	int d = *acc;
+
+	if (d > 32767) d = 32767;
+	if (d < -32767) d = -32767;
+	*acc -= d;
+
+	return d;
 }
 
-#define REPORT_SIZE 3
+static char ThreeDOBuildMouseReport(unsigned char *reportBuffer)
+{
+	int dx, dy;
+
+	if (reportBuffer)
+	{
+		dx = ThreeDOTakeDelta(&mouse_dx);
+		dy = ThreeDOTakeDelta(&mouse_dy);
+
+		reportBuffer[0] = THREEDO_MOUSE_REPORT;
+		reportBuffer[1] = mouse_buttons;
+		reportBuffer[2] = dx;
+		reportBuffer[3] = dx>>8;
+		reportBuffer[4] = dy;
+		reportBuffer[5] = dy>>8;
+	}
+	last_reported_mouse_buttons = mouse_buttons;
+
+	return MOUSE_REPORT_SIZE;
+}
 
 static char ThreeDOBuildReport(unsigned char *reportBuffer, char id)
 {
-	int x,y;
-	unsigned int tmp;
+	unsigned int x,y,z,buttons;
+	unsigned long axes;
+	unsigned char dev = id-1;
+	unsigned char *tmp;
+
+	if (!id || id > THREEDO_MOUSE_REPORT)
+		return 0;	// Report ID from the host (GET_REPORT), not one of ours
+	if (id == THREEDO_MOUSE_REPORT)
+		return ThreeDOBuildMouseReport(reportBuffer);
 	
 	if (reportBuffer)
 	{
-		y = x = 0x80;
+		z = y = x = 0x200;
+		buttons = 0;
 
-		tmp = last_update_state;
+		tmp = last_update_state[dev];
 
-	/* last_update_state format:
-	 * 
-	 * 15 14 13 12 11 10 9 8 7 6 5    4     3  2    1 0
-	 * 1  0  0  L  R  X  P C B A LEFT RIGHT UP DOWN 0 0
-	 */
-		
-		if (tmp&(1<<4)) { x = 0xff; }
-		if (tmp&(1<<5)) { x = 0x00; }
-		if (tmp&(1<<2)) { y = 0xff; }
-		if (tmp&(1<<3)) { y = 0x00; }
-
-		reportBuffer[0] = x;
-		reportBuffer[1] = y;
-		reportBuffer[2] = 0;
-		if (tmp&(1<<6)) reportBuffer[2] |= (1<<0);
-		if (tmp&(1<<7)) reportBuffer[2] |= (1<<1);
-		if (tmp&(1<<8)) reportBuffer[2] |= (1<<2);
-		if (tmp&(1<<9)) reportBuffer[2] |= (1<<3);
-		if (tmp&(1<<10)) reportBuffer[2] |= (1<<4);
-		if (tmp&(1<<11)) reportBuffer[2] |= (1<<5);
-		if (tmp&(1<<12)) reportBuffer[2] |= (1<<6);
+		if (device_type[dev] == THREEDO_JOYPAD)
+		{
+			if (tmp[0]&(1<<2)) { x = 0x3ff; }
+			if (tmp[0]&(1<<1)) { x = 0x000; }
+			if (tmp[0]&(1<<4)) { y = 0x3ff; }
+			if (tmp[0]&(1<<3)) { y = 0x000; }
+
+			if (tmp[0]&(1<<0)) buttons |= (1<<0); // A
+			if (tmp[1]&(1<<7)) buttons |= (1<<1); // B
+			if (tmp[1]&(1<<6)) buttons |= (1<<2); // C
+			if (tmp[1]&(1<<5)) buttons |= (1<<3); // P
+			if (tmp[1]&(1<<4)) buttons |= (1<<4); // X
+			if (tmp[1]&(1<<3)) buttons |= (1<<5); // R
+			if (tmp[1]&(1<<2)) buttons |= (1<<6); // L
+		}
+		else if (device_type[dev] == THREEDO_FLIGHTSTICK)
+		{
+			x = ((tmp[3]<<2)|(tmp[4]>>6))&0x3ff;
+			y = ((tmp[4]<<4)|(tmp[5]>>4))&0x3ff;
+			z = ((tmp[5]<<6)|(tmp[6]>>2))&0x3ff;
+
+			if (tmp[7]&(1<<6)) buttons |= (1<<0); // A
+			if (tmp[7]&(1<<5)) buttons |= (1<<1); // B
+			if (tmp[7]&(1<<4)) buttons |= (1<<2); // C
+			if (tmp[8]&(1<<7)) buttons |= (1<<3); // P
+			if (tmp[8]&(1<<6)) buttons |= (1<<4); // X
+			if (tmp[8]&(1<<4)) buttons |= (1<<5); // R
+			if (tmp[8]&(1<<5)) buttons |= (1<<6); // L
+			if (tmp[7]&(1<<7)) buttons |= (1<<7); // FIRE
+			if (tmp[7]&(1<<3)) buttons |= (1<<8); // UP
+			if (tmp[7]&(1<<2)) buttons |= (1<<9); // DOWN
+			if (tmp[7]&(1<<1)) buttons |= (1<<10); // RIGHT
+			if (tmp[7]&(1<<0)) buttons |= (1<<11); // LEFT
+		}
+
+		/* X, Y and Z are packed as 10 bits fields, LSB first */
+		axes = x | ((unsigned long)y<<10) | ((unsigned long)z<<20);
+
+		reportBuffer[0] = id;
+		reportBuffer[1] = axes;
+		reportBuffer[2] = axes>>8;
+		reportBuffer[3] = axes>>16;
+		reportBuffer[4] = axes>>24;
+		reportBuffer[5] = buttons;
+		reportBuffer[6] = buttons>>8;
 	}
-	last_reported_state = last_update_state;
+	last_reported_type[dev] = device_type[dev];
+	memcpy(last_reported_state[dev], last_update_state[dev], THREEDO_MAX_PACKET);
 
 	return REPORT_SIZE;
 }
@@ -145,30 +338,122 @@ static char ThreeDOBuildReport(unsigned char *reportBuffer, char id)
 const char ThreeDO_usbHidReportDescriptor[] PROGMEM = {
 	0x05, 0x01,			// USAGE_PAGE (Generic Desktop)
     0x09, 0x04,			// USAGE (Joystick)
-    0xa1, 0x01,			//	COLLECTION (Application)
+    0xa1, 0x01,			// COLLECTION (Application)
+    0x85, 1,			//		REPORT_ID (1)
+	0x09, 0x30,			//		USAGE (X)
+    0x09, 0x31,			//		USAGE (Y)
+    0x09, 0x32,			//		USAGE (Z)
+    0x15, 0x00,			//		LOGICAL_MINIMUM (0)
+    0x26, 0xff, 0x03,	//		LOGICAL_MAXIMUM (1023)
+    0x75, 0x0a,			//		REPORT_SIZE (10)
+    0x95, 0x03,			//		REPORT_COUNT (3)
+    0x81, 0x02,			//		INPUT (Data,Var,Abs)
+    0x75, 0x02,			//		REPORT_SIZE (2)
+    0x95, 0x01,			//		REPORT_COUNT (1)
+    0x81, 0x03,			//		INPUT (Cnst,Var,Abs)
+    0x05, 0x09,			//		USAGE_PAGE (Button)
+    0x19, 1,			//   	USAGE_MINIMUM (Button 1)
+    0x29, 16,			//   	USAGE_MAXIMUM (Button 16)
+    0x25, 0x01,			//   	LOGICAL_MAXIMUM (1)
+    0x75, 1,			// 		REPORT_SIZE (1)
+    0x95, 16,			//		REPORT_COUNT (16)
+    0x81, 0x02,			//		INPUT (Data,Var,Abs)
+	0x09, 0x00,         //      USAGE (Undefined) // Used to trig bootloader when SET FEATURE
+    0x26, 0xff, 0x00,   //      LOGICAL_MAXIMUM (255)
+    0x75, 0x08,         //      REPORT_SIZE (8)
+    0x95, 0x01,         //      REPORT_COUNT (1)
+    0xb2, 0x02, 0x01,   //      FEATURE (Data,Var,Abs,Buf)	
+    0xc0,				// END_COLLECTION
+	0x05, 0x01,			// USAGE_PAGE (Generic Desktop)
+    0x09, 0x04,			// USAGE (Joystick)
+    0xa1, 0x01,			// COLLECTION (Application)
+    0x85, 2,			//		REPORT_ID (2)
+	0x09, 0x30,			//		USAGE (X)
+    0x09, 0x31,			//		USAGE (Y)
+    0x09, 0x32,			//		USAGE (Z)
+    0x15, 0x00,			//		LOGICAL_MINIMUM (0)
+    0x26, 0xff, 0x03,	//		LOGICAL_MAXIMUM (1023)
+    0x75, 0x0a,			//		REPORT_SIZE (10)
+    0x95, 0x03,			//		REPORT_COUNT (3)
+    0x81, 0x02,			//		INPUT (Data,Var,Abs)
+    0x75, 0x02,			//		REPORT_SIZE (2)
+    0x95, 0x01,			//		REPORT_COUNT (1)
+    0x81, 0x03,			//		INPUT (Cnst,Var,Abs)
+    0x05, 0x09,			//		USAGE_PAGE (Button)
+    0x19, 1,			//   	USAGE_MINIMUM (Button 1)
+    0x29, 16,			//   	USAGE_MAXIMUM (Button 16)
+    0x25, 0x01,			//   	LOGICAL_MAXIMUM (1)
+    0x75, 1,			// 		REPORT_SIZE (1)
+    0x95, 16,			//		REPORT_COUNT (16)
+    0x81, 0x02,			//		INPUT (Data,Var,Abs)
+    0xc0,				// END_COLLECTION
+	0x05, 0x01,			// USAGE_PAGE (Generic Desktop)
+    0x09, 0x04,			// USAGE (Joystick)
+    0xa1, 0x01,			// COLLECTION (Application)
+    0x85, 3,			//		REPORT_ID (3)
+	0x09, 0x30,			//		USAGE (X)
+    0x09, 0x31,			//		USAGE (Y)
+    0x09, 0x32,			//		USAGE (Z)
+    0x15, 0x00,			//		LOGICAL_MINIMUM (0)
+    0x26, 0xff, 0x03,	//		LOGICAL_MAXIMUM (1023)
+    0x75, 0x0a,			//		REPORT_SIZE (10)
+    0x95, 0x03,			//		REPORT_COUNT (3)
+    0x81, 0x02,			//		INPUT (Data,Var,Abs)
+    0x75, 0x02,			//		REPORT_SIZE (2)
+    0x95, 0x01,			//		REPORT_COUNT (1)
+    0x81, 0x03,			//		INPUT (Cnst,Var,Abs)
+    0x05, 0x09,			//		USAGE_PAGE (Button)
+    0x19, 1,			//   	USAGE_MINIMUM (Button 1)
+    0x29, 16,			//   	USAGE_MAXIMUM (Button 16)
+    0x25, 0x01,			//   	LOGICAL_MAXIMUM (1)
+    0x75, 1,			// 		REPORT_SIZE (1)
+    0x95, 16,			//		REPORT_COUNT (16)
+    0x81, 0x02,			//		INPUT (Data,Var,Abs)
+    0xc0,				// END_COLLECTION
+	0x05, 0x01,			// USAGE_PAGE (Generic Desktop)
+    0x09, 0x04,			// USAGE (Joystick)
+    0xa1, 0x01,			// COLLECTION (Application)
+    0x85, 4,			//		REPORT_ID (4)
+	0x09, 0x30,			//		USAGE (X)
+    0x09, 0x31,			//		USAGE (Y)
+    0x09, 0x32,			//		USAGE (Z)
+    0x15, 0x00,			//		LOGICAL_MINIMUM (0)
+    0x26, 0xff, 0x03,	//		LOGICAL_MAXIMUM (1023)
+    0x75, 0x0a,			//		REPORT_SIZE (10)
+    0x95, 0x03,			//		REPORT_COUNT (3)
+    0x81, 0x02,			//		INPUT (Data,Var,Abs)
+    0x75, 0x02,			//		REPORT_SIZE (2)
+    0x95, 0x01,			//		REPORT_COUNT (1)
+    0x81, 0x03,			//		INPUT (Cnst,Var,Abs)
+    0x05, 0x09,			//		USAGE_PAGE (Button)
+    0x19, 1,			//   	USAGE_MINIMUM (Button 1)
+    0x29, 16,			//   	USAGE_MAXIMUM (Button 16)
+    0x25, 0x01,			//   	LOGICAL_MAXIMUM (1)
+    0x75, 1,			// 		REPORT_SIZE (1)
+    0x95, 16,			//		REPORT_COUNT (16)
+    0x81, 0x02,			//		INPUT (Data,Var,Abs)
+    0xc0,				// END_COLLECTION
+	0x05, 0x01,			// USAGE_PAGE (Generic Desktop)
+    0x09, 0x02,			// USAGE (Mouse)
+    0xa1, 0x01,			// COLLECTION (Application)
+    0x85, 5,			//		REPORT_ID (5)
     0x09, 0x01,			//		USAGE (Pointer)
     0xa1, 0x00,			//		COLLECTION (Physical)
-	0x09, 0x30,			//			USAGE (X)
-    0x09, 0x31,			//			USAGE (Y)
-    0x15, 0x00,			//			LOGICAL_MINIMUM (0)
-    0x26, 0xff, 0x00,	//			LOGICAL_MAXIMUM (255)
-    0x75, 0x08,			//			REPORT_SIZE (8)
-    0x95, 0x02,			//			REPORT_COUNT (2)
-    0x81, 0x02,			//			INPUT (Data,Var,Abs)
     0x05, 0x09,			//			USAGE_PAGE (Button)
     0x19, 1,			//   		USAGE_MINIMUM (Button 1)
-    0x29, 7,			//   		USAGE_MAXIMUM (Button 7)
-    0x15, 0x00,			//   		LOGICAL_MINIMUM (0)
+    0x29, 4,			//   		USAGE_MAXIMUM (Button 4)
     0x25, 0x01,			//   		LOGICAL_MAXIMUM (1)
     0x75, 1,			// 			REPORT_SIZE (1)
     0x95, 8,			//			REPORT_COUNT (8)
     0x81, 0x02,			//			INPUT (Data,Var,Abs)
-	0x09, 0x00,         //          USAGE (Undefined) // Used to trig bootloader when SET FEATURE
-    0x15, 0x00,         //          LOGICAL_MINIMUM (0)
-    0x26, 0xff, 0x00,   //          LOGICAL_MAXIMUM (255)
-    0x75, 0x08,         //          REPORT_SIZE (8)
-    0x95, 0x01,         //          REPORT_COUNT (1)
-    0xb2, 0x02, 0x01,   //          FEATURE (Data,Var,Abs,Buf)	
+    0x05, 0x01,			//			USAGE_PAGE (Generic Desktop)
+	0x09, 0x30,			//			USAGE (X)
+    0x09, 0x31,			//			USAGE (Y)
+    0x16, 0x01, 0x80,	//			LOGICAL_MINIMUM (-32767)
+    0x26, 0xff, 0x7f,	//			LOGICAL_MAXIMUM (32767)
+    0x75, 0x10,			//			REPORT_SIZE (16)
+    0x95, 0x02,			//			REPORT_COUNT (2)
+    0x81, 0x06,			//			INPUT (Data,Var,Rel)
 	0xc0,				//		END_COLLECTION
     0xc0,				// END_COLLECTION
 };
@@ -195,7 +480,7 @@ const char ThreeDO_usbDescrDevice[] PROGMEM = {    /* USB device descriptor */
 };
 
 Gamepad ThreeDOJoy = {
-	.num_reports			=	1,
+	.num_reports			=	THREEDO_MOUSE_REPORT,
 	.reportDescriptorSize	=	sizeof(ThreeDO_usbHidReportDescriptor),
 	.deviceDescriptorSize	=	sizeof(ThreeDO_usbDescrDevice),
 	.init					=	ThreeDOInit,
@@ -130,13 +130,14 @@ static void hardwareInit(void)
 	/* configure timer 0 for a rate of 12M/(1024 * 256) = 45.78 Hz (~22ms) */
 	TCCR0B = (1<<CS02)|(1<<CS00);
 
-	/* configure timer 2 for a rate of 12M/(1024 * 196) = 59.79 Hz (~16.7ms) */
+	/* configure timer 2 for a rate of 12M/(1024 * 118) = 99.31 Hz (~10ms),
+	 * the USB polling interval, so mouse motion is read at the full rate */
 	TCCR2A = (1<<WGM21);
 	TCCR2B = (1<<CS22)|(1<<CS21)|(1<<CS20);
-	OCR2A = 196; // for 60 hz
+	OCR2A = 117; // for 100 hz
 }
 
-static uchar    reportBuffer[6];    /* buffer for HID reports */
+static uchar    reportBuffer[8];    /* buffer for HID reports */
 
 /* ------------------------------------------------------------------------- */
 /* ----------------------------- USB interface ----------------------------- */
@@ -216,7 +217,10 @@ uchar	usbFunctionSetup(uchar data[8])
  */
 uchar   usbFunctionWrite(uchar *data, uchar len)
 {
-	if(data[0]==0x5A)
+	/* Reports are numbered (one per pad on the chain), the bootloader
+	 * feature belongs to report 1 and its ID may precede the 0x5A key.
+	 */
+	if(data[0]==0x5A || (len>1 && data[0]==1 && data[1]==0x5A))
 		jumptobootloader=1;
     return len;
 }
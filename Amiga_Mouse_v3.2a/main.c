@@ -30,63 +30,52 @@
 #include "../bootloader/fuses.h"
 #include "../bootloader/bootloader.h"
 
+#include "mouse.h"
+
 unsigned char jumptobootloader;
 
-static void AmigaMouseInit(void);
+static void MouseInit(void);
 static void UpdateReportBuffer(void);
 
-static unsigned char mouse;
-static unsigned char old_mouse;
-static char mouse_dx;
-static char mouse_dy;
-static int quad_x, quad_y;
+#define MAX_DELTA	127	// Largest delta in the 8 bits report
+#define EDGE_TIMEOUT	4688	// Timer1 ticks (100ms), slower than this the axis is taken as stopped
 
-char QEM [16] = {0,1,-1,2,-1,0,2,1,1,2,0,-1,2,-1,1,0};               // Quadrature Encoder Matrix
-/* QEM explanation:
- *
- * Quadrature from an Amiga mouse is made of two 90 degree out of phase signals that corresponds to
- * two perforated wheels driven by the mouse ball. The perforated weels are hiding or showing IR LED
- * to IR detectors on the other side that generate these signals. There are two pairs of these 
- * signals, two for the horizontal and two for the vertical.
- *
- * Here is an example of a signal of a mouse going up:
- *          ________            ________            ________            ____
- *         /        \          /        \          /        \          /
- * V  ____/          \________/          \________/          \________/
- *              ________            ________            ________
- *             /        \          /        \          /        \
- * VQ ________/          \________/          \________/          \__________
- *
- * Here is an example of a signal of a mouse going down:
- *
- *          ________            ________            ________            ____
- *         /        \          /        \          /        \          /
- * V  ____/          \________/          \________/          \________/
- * 
- * VQ ________            ________            ________            ________
- *            \          /        \          /        \          /
- *             \________/          \________/          \________/
- *
- * Note on these two example the diffence in phase between V and VQ for up and down.
- *
- * Using these generated waves, we can determine by software the delta displacement of the mouse.
- * The following table is generated by combining these signals in two 2-bit value, V, VQ, V' and VQ'.
- *
- *        Actual readed value (V-VQ 2-bit combinasion)
- *        0   1   2   3
- *     ----------------
- *   0 |  0   1  -1   X
- *   
- *   1 | -1   0   X   1
- *
- *   2 |  1   X   0  -1
- *  
- *   3 |  X  -1   1   0
+// Pin change interrupts used by the map
+#define MOUSE_PCIE	((MOUSE_PCMSK0 ? (1<<PCIE0) : 0) | (MOUSE_PCMSK1 ? (1<<PCIE1) : 0) | (MOUSE_PCMSK2 ? (1<<PCIE2) : 0))
+
+/* One axis as counted by the pin change interrupt.
  *
- *   Previous readed value (V-VQ 2-bit combinasion)
+ * A skipped state means an edge was missed. It is counted, and taken as two
+ * steps in the direction of the last valid step (none while still unknown).
  *
- * Note that this can be done for H-HQ in the exact same way.
+ * With MOUSE_INTERPOLATE, each step is also timestamped with Timer1
+ * (12M/256 = 46.875 kHz, ~21us). The time between the last two steps gives
+ * the speed, so the position between steps can be estimated when reporting:
+ * up to MOUSE_SCALE-1 units past the last step, never as far as the next one,
+ * and corrected as soon as the next step (or a change of direction) is seen.
  */
+typedef struct {
+	volatile int steps;				// Steps counted by interrupt, not yet reported
+	volatile signed char dir;		// Direction of the last valid step
+	volatile unsigned int skips;	// Skipped states seen, see the diagnostics feature report
+#ifdef MOUSE_INTERPOLATE
+	volatile unsigned int edge;		// Timer1 time of the last step
+	volatile unsigned int period;	// Timer1 ticks between the last two steps, 0 if unknown
+	volatile unsigned char timed;	// edge is recent, cleared once stopped as Timer1 wraps in ~1.4s
+#endif
+	signed char lead;				// Units reported past the last step
+	int pending;					// Units not reported yet, carried to the next reports
+} MouseAxis;
+
+static MouseAxis axis_x, axis_y;
+static unsigned char old_quad;	// Previous step nibble, already shifted in place in the QUAD index
+
+#ifdef MOUSE_WHEEL_READ
+static MouseAxis axis_w;
+static unsigned char old_wheel;	// Previous wheel quadrature, already shifted in place in the QEM index
+
+static const signed char QEM [16] PROGMEM = {0,1,-1,2,-1,0,2,1,1,2,0,-1,2,-1,1,0};               // Quadrature Encoder Matrix
+#endif
 
 /* ------------------------------------------------------------------------- */
 /* ----------------------------- USB interface ----------------------------- */
@@ -100,14 +89,14 @@ PROGMEM const char usbHidReportDescriptor[66] = { /* USB report descriptor, size
     0xA1, 0x00,                    //   COLLECTION (Physical)
     0x05, 0x09,                    //     USAGE_PAGE (Button)
     0x19, 0x01,                    //     USAGE_MINIMUM
-    0x29, 0x03,                    //     USAGE_MAXIMUM
+    0x29, 0x05,                    //     USAGE_MAXIMUM
     0x15, 0x00,                    //     LOGICAL_MINIMUM (0)
     0x25, 0x01,                    //     LOGICAL_MAXIMUM (1)
-    0x95, 0x03,                    //     REPORT_COUNT (3)
+    0x95, 0x05,                    //     REPORT_COUNT (5)
     0x75, 0x01,                    //     REPORT_SIZE (1)
     0x81, 0x02,                    //     INPUT (Data,Var,Abs)
     0x95, 0x01,                    //     REPORT_COUNT (1)
-    0x75, 0x05,                    //     REPORT_SIZE (5)
+    0x75, 0x03,                    //     REPORT_SIZE (3)
     0x81, 0x03,                    //     INPUT (Const,Var,Abs)
     0x05, 0x01,                    //     USAGE_PAGE (Generic Desktop)
     0x09, 0x30,                    //     USAGE (X)
@@ -122,14 +111,14 @@ PROGMEM const char usbHidReportDescriptor[66] = { /* USB report descriptor, size
     0x15, 0x00,                    //     LOGICAL_MINIMUM (0)
     0x26, 0xff, 0x00,              //     LOGICAL_MAXIMUM (255)
     0x75, 0x08,                    //     REPORT_SIZE (8)
-    0x95, 0x01,                    //     REPORT_COUNT (1)
-    0xb2, 0x02, 0x01,              //     FEATURE (Data,Var,Abs,Buf)	
+    0x95, 0x04,                    //     REPORT_COUNT (4) // GET FEATURE: skipped states X, Y (16 bits each)
+    0xb2, 0x02, 0x01,              //     FEATURE (Data,Var,Abs,Buf)
     0xC0,                          //   END_COLLECTION
     0xC0,                          // END COLLECTION
 };
-/* This is the same report descriptor as seen in a Logitech mouse. The data
- * described by this descriptor consists of 4 bytes:
- *      .  .  .  .  . B2 B1 B0 .... one byte with mouse button states
+/* This is the same report descriptor as seen in a Logitech mouse, with
+ * buttons 4 and 5. The data described by this descriptor consists of 4 bytes:
+ *      .  .  . B4 B3 B2 B1 B0 .... one byte with mouse button states
  *     X7 X6 X5 X4 X3 X2 X1 X0 .... 8 bit signed relative coordinate x
  *     Y7 Y6 Y5 Y4 Y3 Y2 Y1 Y0 .... 8 bit signed relative coordinate y
  *     W7 W6 W5 W4 W3 W2 W1 W0 .... 8 bit signed relative coordinate wheel
@@ -143,6 +132,7 @@ typedef struct{
 
 static report_t reportBuffer;
 static uchar    idleRate;   /* repeat rate for keyboards, never used for mice */
+static uchar    diagBuffer[4];
 
 /* ------------------------------------------------------------------------- */
 
@@ -155,10 +145,20 @@ usbRequest_t    *rq = (void *)data;
      */
     if((rq->bmRequestType & USBRQ_TYPE_MASK) == USBRQ_TYPE_CLASS){    /* class request type */
         if(rq->bRequest == USBRQ_HID_GET_REPORT){  /* wValue: ReportType (highbyte), ReportID (lowbyte) */
-            /* we only have one report type, so don't look at wValue */
+			if(rq->wValue.bytes[1] == 3){	/* Feature report: quadrature diagnostics */
+				cli();
+				diagBuffer[0] = axis_x.skips;
+				diagBuffer[1] = axis_x.skips>>8;
+				diagBuffer[2] = axis_y.skips;
+				diagBuffer[3] = axis_y.skips>>8;
+				sei();
+				usbMsgPtr = (usbMsgPtr_t)diagBuffer;
+				return sizeof(diagBuffer);
+			}
+            /* only one input report, so don't look at the report ID */
             usbMsgPtr = (usbMsgPtr_t)&reportBuffer;
             return sizeof(reportBuffer);
-		}else if(rq->bRequest == USBRQ_HID_SET_REPORT){  
+		}else if(rq->bRequest == USBRQ_HID_SET_REPORT){
 			return USB_NO_MSG;  /* use usbFunctionWrite() to receive data from host */
         }else if(rq->bRequest == USBRQ_HID_GET_IDLE){
             usbMsgPtr = (usbMsgPtr_t)&idleRate;
@@ -167,7 +167,7 @@ usbRequest_t    *rq = (void *)data;
             idleRate = rq->wValue.bytes[1];
         }
     }
-	
+
     return 0;   /* default for not implemented requests: return no data back to host */
 }
 
@@ -191,7 +191,7 @@ __attribute__ ((OS_main)) int main(void)
      * additional hardware initialization.
      */
 	jumptobootloader=0;
-	AmigaMouseInit();
+	MouseInit();
     usbInit();
     usbDeviceDisconnect();  /* enforce re-enumeration, do this while interrupts are disabled! */
     _delay_ms(10);	// 10ms is enough to see the USB disconnection and reconnection
@@ -221,74 +221,164 @@ __attribute__ ((OS_main)) int main(void)
 
 /* ------------------------------------------------------------------------- */
 
-static void AmigaMouseInit(void)
+static void MouseInit(void)
 {
+	// Only the pins of the map are touched, USB is on port D
+	DDRB = (DDRB & ~MOUSE_PINS_B) | MOUSE_DDR_B;
+	PORTB = (PORTB & ~MOUSE_PINS_B) | MOUSE_PORT_B;
+	DDRC = (DDRC & ~MOUSE_PINS_C) | MOUSE_DDR_C;
+	PORTC = (PORTC & ~MOUSE_PINS_C) | MOUSE_PORT_C;
+	DDRD = (DDRD & ~MOUSE_PINS_D) | MOUSE_DDR_D;
+	PORTD = (PORTD & ~MOUSE_PINS_D) | MOUSE_PORT_D;
+
+	// Interrupts on the step lines only, buttons are read when reporting
+	PCMSK0 |= MOUSE_PCMSK0;
+	PCMSK1 |= MOUSE_PCMSK1;
+	PCMSK2 |= MOUSE_PCMSK2;
+	PCICR |= MOUSE_PCIE;
+
+#ifdef MOUSE_INTERPOLATE
+	TCCR1A = 0;
+	TCCR1B = (1<<CS12);	// Timer1 free running at clk/256, step timestamps
+#endif
+
+	_delay_us(10);	// Let the pull-ups settle before the initial read
+	old_quad = MOUSE_STEP_READ()<<MOUSE_STEP_BITS;
+#ifdef MOUSE_WHEEL_READ
+	old_wheel = MOUSE_WHEEL_READ()<<2;
+#endif
+}
 
-#define MOUSE_V		PB0
-#define MOUSE_H 	PB1
-#define MOUSE_VQ	PB2
-#define MOUSE_HQ	PB3
-#define MOUSE_BUT1	PB4
-#define MOUSE_BUT2	PC2
-#define MOUSE_BUT3	PC3
-
-	/* PB0   = PIN1 = V 	(I,1)
-	 * PB1   = PIN2 = H		(I,1)
-	 * PB2   = PIN3 = VQ    (I,1)
-	 * PB3   = PIN4 = HQ	(I,1)
-	 * PC1&3 = PIN5 = BUT2  (I,1)
-	 * PB4   = PIN6 = BUT1  (I,1)
-	 * PB5   = PIN7 = VCC 	(O,1)
-	 * PD7   = PIN8 = GND	(O,0)
-	 * PC0&2 = PIN9 = BUT3	(I,1)
-	 */
-	
-	DDRB &= ~((1<<PB0)|(1<<PB1)|(1<<PB2)|(1<<PB3)|(1<<PB4));
-	PORTB |= ((1<<PB0)|(1<<PB1)|(1<<PB2)|(1<<PB3)|(1<<PB4));
-
-	DDRC &= ~((1<<PC0)|(1<<PC1)|(1<<PC2)|(1<<PC3));
-	PORTC |= ((1<<PC0)|(1<<PC1)|(1<<PC2)|(1<<PC3));
-
-	DDRB |= (1<<PB5);
-	PORTB |= (1<<PB5);
-
-	DDRD |= (1<<PD7);
-	PORTD &= ~(1<<PD7);
-	
-	PCICR |= (1<<PCIE0); // Enable interrupts on PCINT0:7 (PB0-PB7)
-	PCMSK0 |= ((1<<PCINT0)|(1<<PCINT1)|(1<<PCINT2)|(1<<PCINT3)|(1<<PCINT4)); // Enable interrupts on PB0-PB4, V,H,VQ,HQ, button1 change
-
-	mouse_dx = mouse_dy = 0;	// Not moving
-	
-	old_mouse = mouse = ~PINB;	// Initial read
+static inline void MouseStep(MouseAxis *a, signed char d, unsigned int now)
+{
+	if (!d)
+		return;
+	if (d == QEM_SKIP)
+	{
+		a->skips++;
+		d = a->dir*2;
+	}
+	else
+	{
+#ifdef MOUSE_INTERPOLATE
+		unsigned int period = now - a->edge;
+
+		a->period = (a->timed && period < EDGE_TIMEOUT && d == a->dir) ? period : 0;	// Speed unknown after a stop or a reversal
+		a->edge = now;
+		a->timed = 1;
+#endif
+		a->dir = d;
+	}
+	a->steps += d;
 }
 
-ISR(PCINT0_vect) // Trigged whenever a bit change on mouse reading
+#ifdef MOUSE_STEP_ALIAS1
+ISR(MOUSE_STEP_ALIAS1,ISR_ALIASOF(MOUSE_STEP_VECT));
+#endif
+#ifdef MOUSE_STEP_ALIAS2
+ISR(MOUSE_STEP_ALIAS2,ISR_ALIASOF(MOUSE_STEP_VECT));
+#endif
+
+/* Trigged whenever a step line changes. V-USB must get INT0 within 25 cycles,
+ * so this runs with interrupts enabled and its own pin change interrupts
+ * masked. An edge seen meanwhile stays flagged and runs it again on exit.
+ */
+ISR(MOUSE_STEP_VECT,ISR_NOBLOCK)
 {
-	mouse = ~PINB;	// Read port
+	PCICR &= ~MOUSE_PCIE;
+
+#ifdef MOUSE_INTERPOLATE
+	unsigned int now = TCNT1;
+#else
+	unsigned int now = 0;
+#endif
+	unsigned char quad = MOUSE_STEP_READ();	// Read the pins once
 
-	// Apply delta displacement from quadrature generated by the mouse, in x and y.
-	// Quad Format (4 bits): MSB OldHQ OldH ActualHQ ActualH LSB
-	quad_x=((mouse&(1<<MOUSE_H))>>1)|((mouse&(1<<MOUSE_HQ))>>2)|((old_mouse&(1<<MOUSE_H))<<1)|((old_mouse&(1<<MOUSE_HQ)));
-	mouse_dx += QEM[quad_x];
+	// Apply delta displacement of both axes in one lookup.
+	unsigned int delta = pgm_read_word(&QUAD[old_quad|quad]);
+	old_quad = quad<<MOUSE_STEP_BITS;	// Keep previous nibble for the next change.
 
-	// Quad Format (4 bits): MSB OldVQ OldV ActualVQ ActualV LSB
-	quad_y=((mouse&(1<<MOUSE_V)))|((mouse&(1<<MOUSE_VQ))>>1)|((old_mouse&(1<<MOUSE_V))<<2)|((old_mouse&(1<<MOUSE_VQ))<<1);
-	mouse_dy += QEM[quad_y];
+	MouseStep(&axis_x, (signed char)delta, now);
+#if MOUSE_STEP_BITS > 2
+	MouseStep(&axis_y, (signed char)(delta>>8), now);
+#endif
 
-	old_mouse = mouse;	// Keep previous value of the port for quadrature calculation.
+#ifdef MOUSE_WHEEL_READ
+	unsigned char wheel = MOUSE_WHEEL_READ();
+
+	MouseStep(&axis_w, pgm_read_byte(&QEM[old_wheel|wheel]), now);
+	old_wheel = wheel<<2;
+#endif
+
+	cli();	// A pending edge runs after reti, not nested in here
+	PCICR |= MOUSE_PCIE;
+}
+
+/* Steps of one axis since the last report in units of 1/scale step, plus the
+ * interpolated position past the last step. What does not fit in a report
+ * stays for the next one.
+ */
+static char MouseTake(MouseAxis *a, unsigned char scale)
+{
+	int steps;
+	signed char lead = 0;
+	int d;
+#ifdef MOUSE_INTERPOLATE
+	unsigned int elapsed, period;
+	signed char dir;
+#endif
+
+	cli();
+	steps = a->steps;
+	a->steps = 0;
+#ifdef MOUSE_INTERPOLATE
+	elapsed = TCNT1 - a->edge;
+	if (elapsed >= EDGE_TIMEOUT)
+	{
+		a->period = 0;	// Stopped, also keeps elapsed from wrapping around
+		a->timed = 0;	// and the next step from being timed from this edge
+	}
+	period = a->period;
+	dir = a->dir;
+#endif
+	sei();
+
+#ifdef MOUSE_INTERPOLATE
+	// Where the axis should be since the last step at the last measured speed.
+	// Once stopped, hold what was already reported rather than moving back.
+	if (!steps && !period)
+		lead = a->lead;
+	else if (period)
+	{
+		lead = (elapsed < period) ? ((unsigned long)elapsed*scale)/period : scale-1;
+		if (lead > scale-1)
+			lead = scale-1;
+		lead *= dir;
+	}
+#endif
+
+	a->pending += steps*scale + lead - a->lead;
+	a->lead = lead;
+
+	d = a->pending;
+	if (d > MAX_DELTA)
+		d = MAX_DELTA;
+	if (d < -MAX_DELTA)
+		d = -MAX_DELTA;
+	a->pending -= d;
+
+	return d;
 }
 
 static void UpdateReportBuffer(void)
 {
 	// Send up to date delta displacements that happened during the USB polling interval.
-	reportBuffer.dx = mouse_dx;
-	mouse_dx=0;
-
-	reportBuffer.dy = mouse_dy;
-	mouse_dy=0;
-
-	// Button Format (3 bits): MSB BUT3 BUT2 BUT1 LSB
-	reportBuffer.buttonMask = ((mouse&(1<<MOUSE_BUT1))>>4) | (((~PINC)&((1<<MOUSE_BUT2)|(1<<MOUSE_BUT3)))>>1);	// Update Button status
+	reportBuffer.dx = MouseTake(&axis_x, MOUSE_SCALE);
+	reportBuffer.dy = MouseTake(&axis_y, MOUSE_SCALE);
+#ifdef MOUSE_WHEEL_READ
+	reportBuffer.dWheel = MouseTake(&axis_w, 1);
+#endif
+
+	// Button Format (5 bits): MSB BUT5 BUT4 BUT3 BUT2 BUT1 LSB
+	reportBuffer.buttonMask = MOUSE_BUTTONS();
 }
-
@@ -25,12 +25,34 @@
 #include <avr/wdt.h>
 #include <avr/pgmspace.h>
 #include <avr/interrupt.h>
+#include <avr/eeprom.h>
 #include <string.h>
 #include "usbconfig.h"
 #include "apple2joy.h"
+#include "rcpot.h"
+#include "potfilter.h"
 
-#define SETUPDELAY 50	// Time to reset the capacitor back to GND
-#define DIVIDER 5	// Divider of the read value to match with 0-255.
+#define SETUPDELAY 10	// Time to reset the capacitor back to GND (timer1 ticks, 53uS)
+#define DIVIDER 5	// Timer counts per step of the uncalibrated 0-255 range.
+#define TIMEOUT 2400	// Well past full scale (12.8mS) to leave room for trim, a pot still low by then is disconnected
+
+/* Calibration: hold both buttons for ~3s, sweep the stick to all its
+ * limits, let it come back to centre and press a button. Min, centre and
+ * max of each axis are stored in EEPROM and mapped piecewise-linearly on
+ * a 10 bits range.
+ */
+#define AXIS_MAX 1023
+#define AXIS_CENTER 512
+#define DEADZONE 3			// Percent of each half-travel reported as centre
+#define CAL_HOLD 180		// Samples with both buttons held to enter calibration (~3s)
+#define CAL_MIN_HALF 32		// Smallest accepted half-travel in timer counts
+#define CAL_MAGIC 0xA2CA
+#define FILTER_BAND 2		// Jitter held back on the reported axes
+
+/* Calibration states */
+#define CAL_OFF			0
+#define CAL_RELEASE		1	// Waiting for the buttons to be released
+#define CAL_SWEEP		2	// Learning min/max, a button press takes the centre
 
 void mux(char);
 void resetport(char);
@@ -42,10 +64,193 @@ static char apple2BuildReport(unsigned char *reportBuffer, char id);
 
 volatile unsigned int potx,poty;
 volatile unsigned int old_potx,old_poty;
+static PotFilter filter[2];
+
+/* X and Y charge at once, each timestamped by its own pin change group */
+static const RcPot pots[2] = {
+	{ RCPOT_PINCHANGE, &DDRC, &PINC, &PCMSK1, (1<<PC1), 0 },	// POTX on PCINT9
+	{ RCPOT_PINCHANGE, &DDRD, &PIND, &PCMSK2, (1<<PD6), 0 },	// POTY on PCINT22
+};
 
 static unsigned char button_state;
 static unsigned char button_reported_state;
 
+typedef struct {
+	unsigned int magic;
+	unsigned int min[2];
+	unsigned int center[2];
+	unsigned int max[2];
+} Apple2Calibration;
+
+static Apple2Calibration EEMEM ee_calibration;
+static Apple2Calibration calibration;
+
+/* Precomputed map, only updated when the calibration changes */
+static unsigned int low_end[2];		// Last count of the low half, below the deadzone
+static unsigned int high_start[2];	// First count of the high half, above the deadzone
+static unsigned long low_scale[2];	// 16.16 fixed point output steps per count
+static unsigned long high_scale[2];
+
+static unsigned int raw[2];			// Last measured counts, for the centre capture
+static unsigned int sweep_min[2], sweep_max[2];
+static unsigned char cal_state;
+static unsigned char cal_hold;
+static unsigned char save_index;	// Next calibration byte to write, sizeof() when idle
+
+static void apple2Scale(unsigned char i)
+{
+	unsigned int low = calibration.center[i]-calibration.min[i];
+	unsigned int high = calibration.max[i]-calibration.center[i];
+	unsigned int dz_low = ((unsigned long)low*DEADZONE)/100;
+	unsigned int dz_high = ((unsigned long)high*DEADZONE)/100;
+
+	low_end[i] = calibration.center[i]-dz_low;
+	high_start[i] = calibration.center[i]+dz_high;
+	low_scale[i] = ((unsigned long)AXIS_CENTER<<16)/(low-dz_low);
+	high_scale[i] = ((unsigned long)(AXIS_MAX-AXIS_CENTER)<<16)/(high-dz_high);
+}
+
+static void apple2DefaultCalibration(void)
+{
+	// Same as the former fixed divider
+	calibration.magic = CAL_MAGIC;
+	calibration.min[0] = calibration.min[1] = 0;
+	calibration.center[0] = calibration.center[1] = 127*DIVIDER;
+	calibration.max[0] = calibration.max[1] = 255*DIVIDER;
+}
+
+static void apple2LoadCalibration(void)
+{
+	eeprom_read_block(&calibration, &ee_calibration, sizeof(calibration));
+
+	if (calibration.magic != CAL_MAGIC)
+		apple2DefaultCalibration();
+
+	apple2Scale(0);
+	apple2Scale(1);
+}
+
+/* Map timer counts to 0-AXIS_MAX, no division */
+static unsigned int apple2Map(unsigned char i, unsigned int count)
+{
+	unsigned long d;
+
+	if (count <= calibration.min[i])
+		return 0;
+	if (count >= calibration.max[i])
+		return AXIS_MAX;
+
+	if (count < low_end[i])
+	{
+		d = ((unsigned long)(low_end[i]-count)*low_scale[i])>>16;
+		return (d >= AXIS_CENTER) ? 0 : AXIS_CENTER-d;
+	}
+
+	if (count > high_start[i])
+	{
+		d = ((unsigned long)(count-high_start[i])*high_scale[i])>>16;
+		return (d >= AXIS_MAX-AXIS_CENTER) ? AXIS_MAX : AXIS_CENTER+d;
+	}
+
+	return AXIS_CENTER;
+}
+
+static void apple2Calibrate(void)
+{
+	unsigned char both = ((1<<PB5)|(1<<PB0));
+	unsigned char i;
+
+	switch (cal_state)
+	{
+		case CAL_OFF:
+			if (button_state != both)
+			{
+				cal_hold = 0;
+				break;
+			}
+			if (++cal_hold < CAL_HOLD)
+				break;
+
+			cal_hold = 0;
+			for (i=0;i<2;i++)
+				sweep_min[i] = sweep_max[i] = raw[i];
+			cal_state = CAL_RELEASE;
+			break;
+
+		case CAL_RELEASE:
+			if (!button_state)
+				cal_state = CAL_SWEEP;
+			break;
+
+		case CAL_SWEEP:
+			if (!button_state)
+				break;
+
+			cal_state = CAL_OFF;
+
+			for (i=0;i<2;i++)
+			{
+				// Stick not swept, keep what we had
+				if ((raw[i] < sweep_min[i]+CAL_MIN_HALF)||(raw[i]+CAL_MIN_HALF > sweep_max[i]))
+					return;
+			}
+
+			for (i=0;i<2;i++)
+			{
+				calibration.min[i] = sweep_min[i];
+				calibration.center[i] = raw[i];
+				calibration.max[i] = sweep_max[i];
+				apple2Scale(i);
+			}
+			save_index = 0;
+			break;
+	}
+}
+
+/* Learn the travel while sweeping */
+static void apple2Learn(unsigned char i, unsigned int count)
+{
+	raw[i] = count;
+
+	if (cal_state != CAL_SWEEP)
+		return;
+
+	if (count < sweep_min[i]) sweep_min[i] = count;
+	if (count > sweep_max[i]) sweep_max[i] = count;
+}
+
+/* Write the calibration one byte per call, the main loop never waits on
+ * the EEPROM.
+ */
+static void apple2SaveCalibration(void)
+{
+	if (save_index < sizeof(calibration) && eeprom_is_ready())
+	{
+		eeprom_update_byte((unsigned char *)&ee_calibration + save_index, ((unsigned char *)&calibration)[save_index]);
+		save_index++;
+	}
+}
+
+static void apple2Pot(unsigned char i, unsigned int ticks)
+{
+	unsigned int pos;
+
+	// If disconnected, center paddle
+	if (ticks == RCPOT_TIMEDOUT)
+		potFilterInit(&filter[i], AXIS_CENTER, FILTER_BAND);
+	else
+	{
+		apple2Learn(i, ticks);
+		potFilter(&filter[i], apple2Map(i, raw[i]));
+	}
+	pos=filter[i].value;
+
+	if (i)
+		poty=pos;
+	else
+		potx=pos;
+}
+
 static char apple2Init(void)
 {
 	/* PIN1 = PB0 = BUT1 (I,0)
@@ -70,10 +275,18 @@ static char apple2Init(void)
 	DDRC &= ~((1<<PC1)|(1<<PC3));
 	PORTC &= ~((1<<PC1)|(1<<PC3));
 
-	TCCR1B |= ((1<<CS10)|(1<<CS11));// CPU/64 @ 12MHz = 187,5KHz
+	old_potx=potx=AXIS_CENTER;
+	old_poty=poty=AXIS_CENTER;
+	potFilterInit(&filter[0], AXIS_CENTER, FILTER_BAND);
+	potFilterInit(&filter[1], AXIS_CENTER, FILTER_BAND);
+
+	raw[0]=raw[1]=127*DIVIDER;
+	cal_state=CAL_OFF;
+	cal_hold=0;
+	save_index=sizeof(calibration);
+	apple2LoadCalibration();
 
-	old_potx=potx=0;
-	old_poty=poty=0;
+	rcPotInit(pots, 2, ((1<<CS10)|(1<<CS11)), SETUPDELAY, TIMEOUT, apple2Pot); // CPU/64 @ 12MHz = 187,5KHz, free running
 
 	button_state=button_reported_state=0;
 
@@ -85,45 +298,11 @@ static void apple2Update(void)
 	// Read buttons
 	button_state=(PINB&((1<<PB5)|(1<<PB0)));
 
-	potx=poty=0;
-	// Read X in polling using timer1
-	wdt_reset();
-	DDRC |= ((1<<(PC1)));		// Force port to ground (discharge capacitor)
-	_delay_us(SETUPDELAY);	
-	DDRC &= ~((1<<(PC1)));	// Put back port in read mode
-
-	TCNT1=0;					// Reset timer0 value
-	TIFR1|=(1<<TOV1);			// Clear overflow flag
-
-	while((!(PINC&(1<<(PC1))))&&!(TIFR1&(1<<TOV1)));	// Wait until pin comes back up. This will correspond to the t=RC 
-														// where R is the value of the POT, thus the position.
-														// or if overflow flow trigged.
-		
-	potx=TCNT1;	// Give channel the timer read.
-	
-	// If disconnected, center paddle
-	if(TIFR1&(1<<TOV1))
-		potx=127*DIVIDER;
-	
-	// Read Y in polling using timer1
-	wdt_reset();
-	DDRD |= ((1<<(PD6)));		// Force port to ground (discharge capacitor)
-	_delay_us(SETUPDELAY);
-	DDRD &= ~((1<<(PD6)));	// Put back port in read mode
-
-	TCNT1=0;					// Reset timer0 value
-	TIFR1|=(1<<TOV1);			// Clear overflow flag
-
-	while((!(PIND&(1<<(PD6))))&&!(TIFR1&(1<<TOV1)));	// Wait until pin comes back up. This will correspond to the t=RC
-														// where R is the value of the POT, thus the position.
-														// or if overflow flow trigged.
-	
-	poty=TCNT1;	// Give channel the timer read.
-
-	// If disconnected, center paddle
-	if(TIFR1&(1<<TOV1))
-		poty=127*DIVIDER;
+	apple2SaveCalibration();
+	apple2Calibrate();
 
+	// Collect the last measurement and start the next one
+	rcPotPoll();
 }
 
 static char apple2Changed(char id)
@@ -131,38 +310,25 @@ static char apple2Changed(char id)
 	return ((button_state != button_reported_state)||(old_potx != potx)||(old_poty != poty));		
 }
 
-#define REPORT_SIZE 3
+#define REPORT_SIZE 5
 
 static char apple2BuildReport(unsigned char *reportBuffer, char id)
 {
-	int x,y;
 	unsigned char tmp;
 
 	if (reportBuffer)
 	{
-		// Calculate the channel value relative to a char (0-255)
-		x=(potx/DIVIDER);
-		y=(poty/DIVIDER);
-
-		// Clipping
-		if(x>255)
-			x=255;
-		else if(x<0)
-			x=0;
-
-		if(y>255)
-			y=255;
-		else if(y<0)
-			y=0;
-
 		tmp=button_state;
 
-		reportBuffer[0]=(char)x;
-		reportBuffer[1]=(char)y;
+		// Pots are already mapped to 0-AXIS_MAX
+		reportBuffer[0]=potx;
+		reportBuffer[1]=potx>>8;
+		reportBuffer[2]=poty;
+		reportBuffer[3]=poty>>8;
 
-		reportBuffer[2] = 0;
-		if (tmp&(1<<PB5)) reportBuffer[2] |= 0x01;	
-		if (tmp&(1<<PB0)) reportBuffer[2] |= 0x02;
+		reportBuffer[4] = 0;
+		if (tmp&(1<<PB5)) reportBuffer[4] |= 0x01;	
+		if (tmp&(1<<PB0)) reportBuffer[4] |= 0x02;
 	}
 
 	button_reported_state=button_state;
@@ -182,8 +348,8 @@ const char apple2_usbHidReportDescriptor[] PROGMEM = {
     0x09, 0x30,                    //     USAGE (X)
     0x09, 0x31,                    //     USAGE (Y)
     0x15, 0x00,                    //     LOGICAL_MINIMUM (0)
-    0x26, 0xff, 0x00,              //     LOGICAL_MAXIMUM (255)
-    0x75, 0x08,                    //     REPORT_SIZE (8)
+    0x26, 0xff, 0x03,              //     LOGICAL_MAXIMUM (1023)
+    0x75, 0x10,                    //     REPORT_SIZE (16)
     0x95, 0x02,                    //     REPORT_COUNT (2)
     0x81, 0x02,                    //     INPUT (Data,Var,Abs)
     0x05, 0x09,                    //     USAGE_PAGE (Button)
@@ -0,0 +1,49 @@
+#ifndef _rcpot_h__
+#define _rcpot_h__
+
+/* Asynchronous RC pot measurement engine
+ *
+ * Each pot charges a capacitor through its resistance, the time taken to
+ * reach the input threshold gives the position. All capacitors are
+ * discharged together, then released and timestamped against the free
+ * running timer1, either by pin change interrupt (all such pots charge at
+ * once) or by the analog comparator with timer1 input capture (one pot at
+ * a time through the ADC mux, the others held discharged until their turn).
+ *
+ * Nothing blocks: rcPotPoll() is called from the update function, delivers
+ * the results of a finished cycle through the completion callback and
+ * starts the next one. While a cycle runs the main loop keeps servicing USB.
+ *
+ * Uses timer1 (normal mode, compare A/B, input capture), the analog
+ * comparator and the pin change interrupts of all ports.
+ */
+
+#define RCPOT_PINCHANGE		0	// Digital threshold, pin change interrupt
+#define RCPOT_COMPARATOR	1	// Bandgap threshold, analog comparator + ICR1
+
+#define RCPOT_MAX			4
+#define RCPOT_TIMEDOUT		0xFFFF	// No pot on this channel
+
+typedef struct {
+	unsigned char type;
+	volatile unsigned char *ddr;	// Direction register, the capacitor is discharged by driving the pin low
+	volatile unsigned char *pin;	// Input register, for pin change pots
+	volatile unsigned char *pcmsk;	// Pin change mask register, for pin change pots
+	unsigned char mask;				// Pin bit, same in all the registers above
+	unsigned char mux;				// ADC channel, for comparator pots
+} RcPot;
+
+/* clock:     timer1 clock select bits (TCCR1B)
+ * discharge: capacitor discharge time, in timer1 ticks
+ * timeout:   ticks after which a pot still charging is reported as RCPOT_TIMEDOUT
+ * done:      called from rcPotPoll() with each pot's charge time in ticks
+ */
+void rcPotInit(const RcPot *pots, unsigned char count, unsigned char clock, unsigned int discharge, unsigned int timeout, void (*done)(unsigned char pot, unsigned int ticks));
+
+/* Returns 1 if a cycle completed (callbacks made), 0 if still measuring */
+char rcPotPoll(void);
+
+/* Timeout of the following cycles, may be called from the done callback */
+void rcPotSetTimeout(unsigned int timeout);
+
+#endif // _rcpot_h__
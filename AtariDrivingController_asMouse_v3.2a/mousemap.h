@@ -0,0 +1,105 @@
+/* Atari Driving Controller as mouse pin map
+ * Copyright (C) 2021 Francis-Olivier Gradel, B.Eng.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The author may be contacted at info@retronicdesign.com
+ */
+
+#ifndef _mousemap_h__
+#define _mousemap_h__
+
+/* PIN1 = PB0   = XB
+ * PIN2 = PB1   = XA
+ * PIN3 = PB2   = nc
+ * PIN4 = PB3   = nc
+ * PIN5 = PC1&3 = nc
+ * PIN6 = PB4   = BUT1
+ * PIN7 = PB5   = VCC
+ * PIN8 = PD7   = GND
+ * PIN9 = PC0&2 = nc
+ */
+
+#define MOUSE_PINS_B	((1<<PB0)|(1<<PB1)|(1<<PB4)|(1<<PB5))
+#define MOUSE_DDR_B		(1<<PB5)
+#define MOUSE_PORT_B	((1<<PB0)|(1<<PB1)|(1<<PB4)|(1<<PB5))
+#define MOUSE_PINS_D	(1<<PD7)
+#define MOUSE_DDR_D		(1<<PD7)
+
+#define MOUSE_PCMSK0	((1<<PCINT0)|(1<<PCINT1))	// XB,XA
+#define MOUSE_STEP_VECT	PCINT0_vect
+#define MOUSE_STEP_BITS	2	// X only
+#define MOUSE_STEP_READ()	(PINB&0x03)	// Quad Format (2 bits): MSB XA XB LSB
+
+#define MOUSE_SCALE		8	// Report units per step, the knob has few steps per turn
+
+// Button Format (1 bit): BUT1 on PB4
+#define MOUSE_BUTTONS()	((~PINB>>4)&0x01)
+
+/* QEM explanation:
+ *
+ * Quadrature from an Atari Driving controller is made of two 90 degree out of phase signals that corresponds to
+ * two perforated wheels driven by the knob. The perforated wheels are hiding or showing IR LED
+ * to IR detectors on the other side that generate these signals. 
+ *
+ * Here is an example of a signal of the controller going left:
+ *           ________            ________            ________            ____
+ *          /        \          /        \          /        \          /
+ * XB  ____/          \________/          \________/          \________/
+ *              ________            ________            ________
+ *             /        \          /        \          /        \
+ * XA ________/          \________/          \________/          \__________
+ *
+ * Here is an example of a signal of the controller going right:
+ *
+ *           ________            ________            ________            ____
+ *          /        \          /        \          /        \          /
+ * XB  ____/          \________/          \________/          \________/
+ * 
+ * XA ________            ________            ________            ________
+ *            \          /        \          /        \          /
+ *             \________/          \________/          \________/
+ *
+ * Note on these two example the difference in phase between XB and XA for up and down.
+ *
+ * Using these generated waves, we can determine by software the delta displacement of the mouse.
+ * The following table is generated by combining these signals in two 2-bit value, XB, XA, XB' and XA'.
+ *
+ *        Actual read value (XB-XA 2-bit combination)
+ *        0   1   2   3
+ *     ----------------
+ *   0 |  0   1  -1   X
+ *   
+ *   1 | -1   0   X   1
+ *
+ *   2 |  1   X   0  -1
+ *  
+ *   3 |  X  -1   1   0
+ *
+ *   Previous read value (XB-XA 2-bit combination)
+ *
+ */
+
+/* QUAD: the QEM above, indexed by the old and new quadrature of the pins
+ * (not inverted): MSB old XA XB, new XA XB LSB.
+ */
+static const unsigned int QUAD[16] PROGMEM = {
+	/* 0 */ QD( 0, 0),QD(-1, 0),QD( 1, 0),QD( 2, 0),
+	/* 1 */ QD( 1, 0),QD( 0, 0),QD( 2, 0),QD(-1, 0),
+	/* 2 */ QD(-1, 0),QD( 2, 0),QD( 0, 0),QD( 1, 0),
+	/* 3 */ QD( 2, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),
+};
+
+#endif // _mousemap_h__
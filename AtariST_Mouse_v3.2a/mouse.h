@@ -0,0 +1,77 @@
+#ifndef _mouse_h__
+#define _mouse_h__
+
+/* Pin map of a mouse adapter, given at compile time by mousemap.h.
+ *
+ * main.c is the same for every mouse adapter. It builds the port setup, the
+ * pin change interrupt and the report from the map, so that each mapping gets
+ * one table lookup per edge with no indirection at run time.
+ *
+ * Required:
+ *   MOUSE_STEP_VECT     Pin change vector of the step lines
+ *   MOUSE_STEP_BITS     Width of the step nibble: 2 for X only, 4 for X and Y
+ *   MOUSE_STEP_READ()   Step nibble read from the pins, once per interrupt
+ *   QUAD[]              Steps in PROGMEM, QD(dx,dy) indexed by the old nibble
+ *                       (shifted by MOUSE_STEP_BITS) ORed with the new one
+ *   MOUSE_BUTTONS()     Pressed buttons, bit 0 is button 1, up to 5 buttons
+ *
+ * Optional:
+ *   MOUSE_PINS_B/C/D    Port bits used by the adapter, others are left alone
+ *   MOUSE_DDR_B/C/D     Outputs among them (VCC, GND)
+ *   MOUSE_PORT_B/C/D    High outputs and pulled-up inputs among them
+ *   MOUSE_PCMSK0/1/2    Pin change interrupts of the step and wheel lines
+ *   MOUSE_STEP_ALIAS1/2 Other pin change vectors, aliased to MOUSE_STEP_VECT
+ *   MOUSE_WHEEL_READ()  Wheel quadrature (MSB B A LSB), on the step vectors
+ *   MOUSE_SCALE         Report units per step (1)
+ *   MOUSE_INTERPOLATE   Estimate the position between two steps from the step
+ *                       rate, in 1/MOUSE_SCALE step (uses Timer1)
+ */
+
+/* QUAD entry: dx in the low byte, dy in the high byte, QEM_SKIP for a skipped state */
+#define QD(dx,dy) ((unsigned int)(unsigned char)(dx)|((unsigned int)(unsigned char)(dy)<<8))
+
+#define QEM_SKIP	2	// X in the QEM: skipped state, both lines changed at once
+
+#include "mousemap.h"
+
+#ifndef MOUSE_PINS_B
+#define MOUSE_PINS_B	0
+#endif
+#ifndef MOUSE_PINS_C
+#define MOUSE_PINS_C	0
+#endif
+#ifndef MOUSE_PINS_D
+#define MOUSE_PINS_D	0
+#endif
+#ifndef MOUSE_DDR_B
+#define MOUSE_DDR_B		0
+#endif
+#ifndef MOUSE_DDR_C
+#define MOUSE_DDR_C		0
+#endif
+#ifndef MOUSE_DDR_D
+#define MOUSE_DDR_D		0
+#endif
+#ifndef MOUSE_PORT_B
+#define MOUSE_PORT_B	0
+#endif
+#ifndef MOUSE_PORT_C
+#define MOUSE_PORT_C	0
+#endif
+#ifndef MOUSE_PORT_D
+#define MOUSE_PORT_D	0
+#endif
+#ifndef MOUSE_PCMSK0
+#define MOUSE_PCMSK0	0
+#endif
+#ifndef MOUSE_PCMSK1
+#define MOUSE_PCMSK1	0
+#endif
+#ifndef MOUSE_PCMSK2
+#define MOUSE_PCMSK2	0
+#endif
+#ifndef MOUSE_SCALE
+#define MOUSE_SCALE		1
+#endif
+
+#endif // _mouse_h__
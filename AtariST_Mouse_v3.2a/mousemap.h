@@ -0,0 +1,122 @@
+/* "AtariST" mouse pin map
+ * Copyright (C) 2021 Francis-Olivier Gradel, B.Eng.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The author may be contacted at info@retronicdesign.com
+ */
+
+#ifndef _mousemap_h__
+#define _mousemap_h__
+
+/* PIN1 = PB0   = XB
+ * PIN2 = PB1   = XA
+ * PIN3 = PB2   = YA
+ * PIN4 = PB3   = YB
+ * PIN5 = PC1&3 = BUT3
+ * PIN6 = PB4   = BUT1
+ * PIN7 = PB5   = VCC
+ * PIN8 = PD7   = GND
+ * PIN9 = PC0&2 = BUT2
+ */
+
+#define MOUSE_PINS_B	((1<<PB0)|(1<<PB1)|(1<<PB2)|(1<<PB3)|(1<<PB4)|(1<<PB5))
+#define MOUSE_DDR_B		(1<<PB5)
+#define MOUSE_PORT_B	((1<<PB0)|(1<<PB1)|(1<<PB2)|(1<<PB3)|(1<<PB4)|(1<<PB5))
+#define MOUSE_PINS_C	((1<<PC0)|(1<<PC1)|(1<<PC2)|(1<<PC3))
+#define MOUSE_PORT_C	((1<<PC0)|(1<<PC1)|(1<<PC2)|(1<<PC3))
+#define MOUSE_PINS_D	(1<<PD7)
+#define MOUSE_DDR_D		(1<<PD7)
+
+#define MOUSE_PCMSK0	((1<<PCINT0)|(1<<PCINT1)|(1<<PCINT2)|(1<<PCINT3))	// XB,XA,YA,YB
+#define MOUSE_STEP_VECT	PCINT0_vect
+#define MOUSE_STEP_BITS	4
+#define MOUSE_STEP_READ()	(PINB&0x0F)	// Quad Format (4 bits): MSB YB YA XA XB LSB
+
+// Button Format (3 bits): MSB BUT3 BUT2 BUT1 LSB, BUT1 on PB4, BUT2 on PC2 and BUT3 on PC3
+#define MOUSE_BUTTONS()	(((~PINB>>4)&0x01)|((~PINC>>1)&0x06))
+
+/* QEM explanation:
+ *
+ * Quadrature from an AtariST mouse is made of two 90 degree out of phase signals that corresponds to
+ * two perforated wheels driven by the mouse ball. The perforated weels are hiding or showing IR LED
+ * to IR detectors on the other side that generate these signals. There are two pairs of these 
+ * signals, two for the horizontal and two for the vertical.
+ *
+ * Here is an example of a signal of a mouse going up:
+ *           ________            ________            ________            ____
+ *          /        \          /        \          /        \          /
+ * YB  ____/          \________/          \________/          \________/
+ *              ________            ________            ________
+ *             /        \          /        \          /        \
+ * YA ________/          \________/          \________/          \__________
+ *
+ * Here is an example of a signal of a mouse going down:
+ *
+ *           ________            ________            ________            ____
+ *          /        \          /        \          /        \          /
+ * YB  ____/          \________/          \________/          \________/
+ * 
+ * YA ________            ________            ________            ________
+ *            \          /        \          /        \          /
+ *             \________/          \________/          \________/
+ *
+ * Note on these two example the diffence in phase between YB and YA for up and down.
+ *
+ * Using these generated waves, we can determine by software the delta displacement of the mouse.
+ * The following table is generated by combining these signals in two 2-bit value, YB, YA, YB' and YA'.
+ *
+ *        Actual readed value (YB-YA 2-bit combinasion)
+ *        0   1   2   3
+ *     ----------------
+ *   0 |  0   1  -1   X
+ *   
+ *   1 | -1   0   X   1
+ *
+ *   2 |  1   X   0  -1
+ *  
+ *   3 |  X  -1   1   0
+ *
+ *   Previous readed value (YB-YA 2-bit combinasion)
+ *
+ * Note that this can be done for XA-XB in the exact same way.
+ */
+
+/* QUAD: the QEM above applied to both axes at once, indexed by the old and
+ * new quadrature nibbles: MSB old nibble, new nibble LSB.
+ * Nibble format: MSB YB YA XA XB LSB (PB3-PB0)
+ * Each entry is dx in the low byte and dy in the high byte, read with a
+ * single pgm_read_word() in the ISR.
+ */
+static const unsigned int QUAD[256] PROGMEM = {
+	/* 0 */ QD( 0, 0),QD(-1, 0),QD( 1, 0),QD( 2, 0),QD( 0,-1),QD(-1,-1),QD( 1,-1),QD( 2,-1),QD( 0, 1),QD(-1, 1),QD( 1, 1),QD( 2, 1),QD( 0, 2),QD(-1, 2),QD( 1, 2),QD( 2, 2),
+	/* 1 */ QD( 1, 0),QD( 0, 0),QD( 2, 0),QD(-1, 0),QD( 1,-1),QD( 0,-1),QD( 2,-1),QD(-1,-1),QD( 1, 1),QD( 0, 1),QD( 2, 1),QD(-1, 1),QD( 1, 2),QD( 0, 2),QD( 2, 2),QD(-1, 2),
+	/* 2 */ QD(-1, 0),QD( 2, 0),QD( 0, 0),QD( 1, 0),QD(-1,-1),QD( 2,-1),QD( 0,-1),QD( 1,-1),QD(-1, 1),QD( 2, 1),QD( 0, 1),QD( 1, 1),QD(-1, 2),QD( 2, 2),QD( 0, 2),QD( 1, 2),
+	/* 3 */ QD( 2, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 2,-1),QD( 1,-1),QD(-1,-1),QD( 0,-1),QD( 2, 1),QD( 1, 1),QD(-1, 1),QD( 0, 1),QD( 2, 2),QD( 1, 2),QD(-1, 2),QD( 0, 2),
+	/* 4 */ QD( 0, 1),QD(-1, 1),QD( 1, 1),QD( 2, 1),QD( 0, 0),QD(-1, 0),QD( 1, 0),QD( 2, 0),QD( 0, 2),QD(-1, 2),QD( 1, 2),QD( 2, 2),QD( 0,-1),QD(-1,-1),QD( 1,-1),QD( 2,-1),
+	/* 5 */ QD( 1, 1),QD( 0, 1),QD( 2, 1),QD(-1, 1),QD( 1, 0),QD( 0, 0),QD( 2, 0),QD(-1, 0),QD( 1, 2),QD( 0, 2),QD( 2, 2),QD(-1, 2),QD( 1,-1),QD( 0,-1),QD( 2,-1),QD(-1,-1),
+	/* 6 */ QD(-1, 1),QD( 2, 1),QD( 0, 1),QD( 1, 1),QD(-1, 0),QD( 2, 0),QD( 0, 0),QD( 1, 0),QD(-1, 2),QD( 2, 2),QD( 0, 2),QD( 1, 2),QD(-1,-1),QD( 2,-1),QD( 0,-1),QD( 1,-1),
+	/* 7 */ QD( 2, 1),QD( 1, 1),QD(-1, 1),QD( 0, 1),QD( 2, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 2, 2),QD( 1, 2),QD(-1, 2),QD( 0, 2),QD( 2,-1),QD( 1,-1),QD(-1,-1),QD( 0,-1),
+	/* 8 */ QD( 0,-1),QD(-1,-1),QD( 1,-1),QD( 2,-1),QD( 0, 2),QD(-1, 2),QD( 1, 2),QD( 2, 2),QD( 0, 0),QD(-1, 0),QD( 1, 0),QD( 2, 0),QD( 0, 1),QD(-1, 1),QD( 1, 1),QD( 2, 1),
+	/* 9 */ QD( 1,-1),QD( 0,-1),QD( 2,-1),QD(-1,-1),QD( 1, 2),QD( 0, 2),QD( 2, 2),QD(-1, 2),QD( 1, 0),QD( 0, 0),QD( 2, 0),QD(-1, 0),QD( 1, 1),QD( 0, 1),QD( 2, 1),QD(-1, 1),
+	/* A */ QD(-1,-1),QD( 2,-1),QD( 0,-1),QD( 1,-1),QD(-1, 2),QD( 2, 2),QD( 0, 2),QD( 1, 2),QD(-1, 0),QD( 2, 0),QD( 0, 0),QD( 1, 0),QD(-1, 1),QD( 2, 1),QD( 0, 1),QD( 1, 1),
+	/* B */ QD( 2,-1),QD( 1,-1),QD(-1,-1),QD( 0,-1),QD( 2, 2),QD( 1, 2),QD(-1, 2),QD( 0, 2),QD( 2, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 2, 1),QD( 1, 1),QD(-1, 1),QD( 0, 1),
+	/* C */ QD( 0, 2),QD(-1, 2),QD( 1, 2),QD( 2, 2),QD( 0, 1),QD(-1, 1),QD( 1, 1),QD( 2, 1),QD( 0,-1),QD(-1,-1),QD( 1,-1),QD( 2,-1),QD( 0, 0),QD(-1, 0),QD( 1, 0),QD( 2, 0),
+	/* D */ QD( 1, 2),QD( 0, 2),QD( 2, 2),QD(-1, 2),QD( 1, 1),QD( 0, 1),QD( 2, 1),QD(-1, 1),QD( 1,-1),QD( 0,-1),QD( 2,-1),QD(-1,-1),QD( 1, 0),QD( 0, 0),QD( 2, 0),QD(-1, 0),
+	/* E */ QD(-1, 2),QD( 2, 2),QD( 0, 2),QD( 1, 2),QD(-1, 1),QD( 2, 1),QD( 0, 1),QD( 1, 1),QD(-1,-1),QD( 2,-1),QD( 0,-1),QD( 1,-1),QD(-1, 0),QD( 2, 0),QD( 0, 0),QD( 1, 0),
+	/* F */ QD( 2, 2),QD( 1, 2),QD(-1, 2),QD( 0, 2),QD( 2, 1),QD( 1, 1),QD(-1, 1),QD( 0, 1),QD( 2,-1),QD( 1,-1),QD(-1,-1),QD( 0,-1),QD( 2, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),
+};
+
+#endif // _mousemap_h__
@@ -31,10 +31,19 @@
 #include <string.h>
 #include "usbconfig.h"
 #include "atarijoypad.h"
+#include "rcpot.h"
 
-#define SETUPDELAY 50	// Time to reset the capacitor back to GND
+#define SETUPDELAY 3		// Time to reset the capacitors back to GND (timer1 ticks, 64uS)
 #define DIVIDER 1		// Divider of the read value to match with 0-255 (Atari Paddles 1Mohm)
 //#define DIVIDER 0	// Divider of the read value to match with 0-255 (C64 Paddles 460Kohm)
+#define TIMEOUT 0x280	// Past full scale of a 1Mohm paddle (13.6mS), no paddle on this channel
+
+/* Joystick/paddles detection with hysteresis: a channel must time out for
+ * DETECT_COUNT measurements in a row to switch to joystick, and both must be
+ * well in range as many times to switch back to paddles.
+ */
+#define DETECT_COUNT 8
+#define PADDLE_IN_RANGE 0x240
 
 static char atariJoyPadInit(void);
 static void atariJoyPadUpdate(void);
@@ -43,11 +52,31 @@ static char atariJoyPadBuildReport(unsigned char *reportBuffer, char id);
 
 volatile unsigned int channel[2];
 volatile unsigned int old_channel[2];
-volatile unsigned char current_channel;
+
+/* Both paddles are measured back-to-back in one cycle through the
+ * comparator and the ADC mux, the second held to GND until its turn.
+ */
+static const RcPot pots[2] = {
+	{ RCPOT_COMPARATOR, &DDRC, &PINC, 0, (1<<PC0), 0 },
+	{ RCPOT_COMPARATOR, &DDRC, &PINC, 0, (1<<PC1), 1 },
+};
+
+static unsigned char paddles_mode;
+static unsigned char reported_paddles_mode;
+static unsigned char detect_count;
 
 volatile unsigned char last_update_state;
 volatile unsigned char last_reported_state;
 
+static void atariJoyPadPot(unsigned char i, unsigned int ticks)
+{
+	// No paddle on this channel
+	if (ticks == RCPOT_TIMEDOUT)
+		ticks = TIMEOUT;
+
+	channel[i] = ticks;
+}
+
 static char atariJoyPadInit(void)
 {
 	/* PB0   = PIN1 = UP 	   (I,1)
@@ -73,26 +102,35 @@ static char atariJoyPadInit(void)
 
 	DDRC &= ~((1<<PC0)|(1<<PC1));
 	PORTC &= ~((1<<PC0)|(1<<PC1));
-	
-	ADCSRB |= (1<<ACME);	// Comparator negative input on ADC MUX.
-	ADCSRA &= ~(1<<ADEN);	// ADC off, Comparator on.
-	ACSR |= ((1<<ACBG)|(1<<ACIC)|(1<<ACIS1)); // Comparator positive input on BANDGAP. 
-	
-	TCCR1B |= ((1<<CS12));// CPU/256 @ 12MHz = 46.875khz (21.33uS/bit)
+
+	rcPotInit(pots, 2, (1<<CS12), SETUPDELAY, TIMEOUT, atariJoyPadPot); // CPU/256 @ 12MHz = 46.875khz (21.33uS/bit), free running
 
 	old_channel[0]=channel[0]=0;
 	old_channel[1]=channel[1]=0;
-	current_channel=0;
+
+	paddles_mode=reported_paddles_mode=0;
+	detect_count=0;
 
 	last_update_state=last_reported_state=0;
 
 	return 0;
 }
 
-ISR(ANALOG_COMP_vect)
+static void atariJoyPadDetect(void)
 {
-	channel[current_channel]=ICR1;		// Put triggered timer value in corresponding channel value
-	ACSR &= ~(1<<ACIE); // Interrupt disable on comparator
+	unsigned char out_of_range = (channel[0]>=TIMEOUT||channel[1]>=TIMEOUT);
+	unsigned char in_range = (channel[0]<PADDLE_IN_RANGE&&channel[1]<PADDLE_IN_RANGE);
+
+	if ((paddles_mode && out_of_range) || (!paddles_mode && in_range))
+	{
+		if (++detect_count >= DETECT_COUNT)
+		{
+			paddles_mode = !paddles_mode;
+			detect_count = 0;
+		}
+	}
+	else
+		detect_count = 0;
 }
 
 static void atariJoyPadUpdate(void)
@@ -100,20 +138,14 @@ static void atariJoyPadUpdate(void)
 	// Read buttons
 	last_update_state = ((PINB&0x1F));
 	
-	//Update Pots
-	current_channel=(current_channel+1)%2;
-	ADMUX = current_channel;
-	DDRC |= (1<<(PC0+current_channel)); // Force ground
-	_delay_us(SETUPDELAY);
-	DDRC &= ~(1<<(PC0+current_channel)); // Release ground
-	TCNT1=0; // Reset timer1	
-	ACSR |= (1<<ACI); // Clear Interrupt Flag. This is needed when paddles are disconnected
-	ACSR |= ((1<<ACIE)); // Interrupt enable on comparator and clear flag
+	// Previous cycle still running (slow paddles), keep the previous values
+	if (rcPotPoll())
+		atariJoyPadDetect();
 }
 
 static char atariJoyPadChanged(char id)
 {
-	return ((last_update_state != last_reported_state)||(old_channel[0] != channel[0])||(old_channel[1] != channel[1]));;
+	return ((last_update_state != last_reported_state)||(paddles_mode != reported_paddles_mode)||(old_channel[0] != channel[0])||(old_channel[1] != channel[1]));
 }
 
 #define REPORT_SIZE 3
@@ -127,7 +159,7 @@ static char atariJoyPadBuildReport(unsigned char *reportBuffer, char id)
 	{
 		tmp = last_update_state ^ 0xff; // All buttons cleared
 		
-		if(channel[0]>0x300||channel[1]>0x300) // Paddles out of range so joystick connected
+		if(!paddles_mode) // Paddles out of range so joystick connected
 		{
 			y = x = 0x80;
 		
@@ -166,6 +198,7 @@ static char atariJoyPadBuildReport(unsigned char *reportBuffer, char id)
 	}
 
 	last_reported_state = last_update_state;
+	reported_paddles_mode = paddles_mode;
 	
 	old_channel[0]=channel[0];
 	old_channel[1]=channel[1];
@@ -25,13 +25,35 @@
 #include <avr/wdt.h>
 #include <avr/pgmspace.h>
 #include <avr/interrupt.h>
+#include <avr/eeprom.h>
 #include <string.h>
 #include "usbconfig.h"
 #include "ataripaddles.h"
+#include "rcpot.h"
+#include "potfilter.h"
+
+#define SETUPDELAY 10	// Time to reset the capacitor back to GND (timer1 ticks, 53uS)
+#define TIMEOUT 7200	// Just past full scale of a 1Mohm paddle, a pot still low by then is disconnected
+#define TIMEOUT_PROBE 64	// Cycles with a calibrated timeout between two full length ones (~1s)
+
+/* Paddles are self-calibrating: the range of timer counts seen on each
+ * paddle is learned and stored in EEPROM, so the same image serves Atari
+ * (1Mohm, ~6400 counts) and C64 (470Kohm, ~3000 counts) paddles.
+ * The range only grows: hold both buttons while plugging the adapter to
+ * forget it, e.g. when going back from Atari to C64 paddles.
+ */
+#define PADDLE_BITS 10		// Logical range of the reported axes
+//#define PADDLE_BITS 12
+#define PADDLE_MAX ((1<<PADDLE_BITS)-1)
+#define PADDLE_CENTER (1<<(PADDLE_BITS-1))
+
+#define CAL_DEFAULT_MIN 0xFFFF	// Nothing learned, the first readings set the minimum and it extends down
+#define CAL_DEFAULT_MAX 3060	// C64 full scale, a 1Mohm paddle extends it on first turn
+#define CAL_MIN_SPAN 256		// Never scale up more than this span allows
+#define CAL_MAGIC 0xCA1C
+#define CAL_SAVE_DELAY 120		// Samples without range change before saving (~2s)
 
-#define SETUPDELAY 50	// Time to reset the capacitor back to GND
-#define DIVIDER 25		// Divider of the read value to match with 0-255 (Atari Paddles 1Mohm)
-//#define DIVIDER 12	// Divider of the read value to match with 0-255 (C64 Paddles 460Kohm)
+#define FILTER_BAND (1<<(PADDLE_BITS-9))	// Jitter held back, 2 steps at 10 bits
 
 void mux(char);
 void resetport(char);
@@ -43,10 +65,159 @@ static char atariPaddlesBuildReport(unsigned char *reportBuffer, char id);
 
 volatile unsigned int channel[2];
 volatile unsigned int old_channel[2];
+static PotFilter filter[2];
+
+/* Both pots charge at once and are timestamped by pin change interrupt */
+static const RcPot pots[2] = {
+	{ RCPOT_PINCHANGE, &DDRC, &PINC, &PCMSK1, (1<<PC0), 0 },
+	{ RCPOT_PINCHANGE, &DDRC, &PINC, &PCMSK1, (1<<PC1), 0 },
+};
 
 static unsigned char button_state;
 static unsigned char button_reported_state;
 
+typedef struct {
+	unsigned int magic;
+	unsigned int min[2];
+	unsigned int max[2];
+} PaddleCalibration;
+
+static PaddleCalibration EEMEM ee_calibration;
+static PaddleCalibration calibration;
+
+static unsigned long scale[2];		// PADDLE_MAX/(max-min) in 16.16 fixed point
+static unsigned int last_count[2];	// Previous raw reading, a range extension must be seen twice
+static unsigned char save_delay;	// Countdown to the next EEPROM save, 0 if nothing to save
+static unsigned char save_index;	// Next calibration byte to write, sizeof() when idle
+
+/* A cycle only waits a quarter past the largest calibrated count, the
+ * margin lets the range still extend. A pot timing out there is held and
+ * checked by a full length cycle, and one full length cycle every
+ * TIMEOUT_PROBE finds a paddle plugged into an empty port.
+ */
+static unsigned int timeout;		// Timeout of the cycle being measured
+static unsigned char probe;			// Calibrated cycles left before the next full length one
+static unsigned char disconnected;	// One bit per paddle, timed out on a full length cycle
+
+static void atariPaddlesScale(unsigned char i)
+{
+	unsigned int span = (calibration.max[i] > calibration.min[i]) ? calibration.max[i]-calibration.min[i] : 0;
+
+	if (span < CAL_MIN_SPAN)
+		span = CAL_MIN_SPAN;
+
+	// Only computed when the range changes, reports just multiply and shift
+	scale[i] = ((unsigned long)PADDLE_MAX<<16)/span;
+}
+
+static void atariPaddlesLoadCalibration(char reset)
+{
+	eeprom_read_block(&calibration, &ee_calibration, sizeof(calibration));
+
+	if (reset || calibration.magic != CAL_MAGIC)
+	{
+		calibration.magic = CAL_MAGIC;
+		calibration.min[0] = calibration.min[1] = CAL_DEFAULT_MIN;
+		calibration.max[0] = calibration.max[1] = CAL_DEFAULT_MAX;
+		save_delay = 1;
+	}
+
+	atariPaddlesScale(0);
+	atariPaddlesScale(1);
+}
+
+/* Learn the range from a raw reading, returns the scaled position */
+static unsigned int atariPaddlesCalibrate(unsigned char i, unsigned int count)
+{
+	unsigned int previous = last_count[i];
+	unsigned long pos;
+
+	last_count[i] = count;
+
+	// Extend the range only when two readings in a row agree, a single
+	// glitch must not widen it for good.
+	if (count < calibration.min[i] && previous < calibration.min[i])
+	{
+		calibration.min[i] = (count > previous) ? count : previous;
+		atariPaddlesScale(i);
+		save_delay = CAL_SAVE_DELAY;
+	}
+	else if (count > calibration.max[i] && previous > calibration.max[i])
+	{
+		calibration.max[i] = (count < previous) ? count : previous;
+		atariPaddlesScale(i);
+		save_delay = CAL_SAVE_DELAY;
+	}
+
+	if (count <= calibration.min[i])
+		return PADDLE_MAX; // Inverted, minimum resistance is full right
+
+	pos = ((unsigned long)(count-calibration.min[i])*scale[i])>>16;
+	if (pos > PADDLE_MAX)
+		pos = PADDLE_MAX;
+
+	return PADDLE_MAX-pos; // Invert value
+}
+
+/* Write the calibration one byte per call once the range has settled, so
+ * the main loop never waits on the EEPROM.
+ */
+static void atariPaddlesSaveCalibration(void)
+{
+	if (save_delay)
+	{
+		if (--save_delay == 0)
+			save_index = 0;
+		return;
+	}
+
+	if (save_index < sizeof(calibration) && eeprom_is_ready())
+	{
+		eeprom_update_byte((unsigned char *)&ee_calibration + save_index, ((unsigned char *)&calibration)[save_index]);
+		save_index++;
+	}
+}
+
+static void atariPaddlesTimeout(void)
+{
+	unsigned int t = (calibration.max[0] > calibration.max[1]) ? calibration.max[0] : calibration.max[1];
+
+	t += t/4;
+	if (t > TIMEOUT || !probe)
+	{
+		t = TIMEOUT;
+		probe = TIMEOUT_PROBE;
+	}
+	else
+		probe--;
+
+	timeout = t;
+	rcPotSetTimeout(t);
+}
+
+static void atariPaddlesPot(unsigned char i, unsigned int ticks)
+{
+	if (ticks != RCPOT_TIMEDOUT)
+	{
+		disconnected &= ~(1<<i);
+		potFilter(&filter[i], atariPaddlesCalibrate(i, ticks));
+	}
+	else if (timeout == TIMEOUT)
+	{
+		// If disconnected, center paddle
+		disconnected |= (1<<i);
+		potFilterInit(&filter[i], PADDLE_CENTER, FILTER_BAND);
+	}
+	else if (!(disconnected & (1<<i)))
+		probe = 0;	// Past the calibrated range, hold the position until a full length cycle
+
+	channel[i]=filter[i].value;
+
+	// Both paddles done, set the timeout of the next cycle
+	if (i == 1)
+		atariPaddlesTimeout();
+}
+
 static char atariPaddlesInit(void)
 {
 	/* PIN1 = PB0 = nc
@@ -73,10 +244,21 @@ static char atariPaddlesInit(void)
 	DDRC &= ~((1<<PC0)|(1<<PC1));
 	PORTC &= ~((1<<PC0)|(1<<PC1));
 
-	TCCR1B |= ((1<<CS10)|(1<<CS11));// CPU/64 @ 12MHz = 187,5KHz
+	old_channel[0]=channel[0]=PADDLE_CENTER;
+	old_channel[1]=channel[1]=PADDLE_CENTER;
+	potFilterInit(&filter[0], PADDLE_CENTER, FILTER_BAND);
+	potFilterInit(&filter[1], PADDLE_CENTER, FILTER_BAND);
+
+	save_delay=0;
+	save_index=sizeof(calibration);
+	last_count[0]=last_count[1]=0xFFFF;
+	_delay_us(100);
+	atariPaddlesLoadCalibration((PINB&((1<<PB2)|(1<<PB3)))==0);
 
-	old_channel[0]=channel[0]=0;
-	old_channel[1]=channel[1]=0;
+	timeout=TIMEOUT;	// First cycle full length
+	probe=TIMEOUT_PROBE;
+	disconnected=0;
+	rcPotInit(pots, 2, ((1<<CS10)|(1<<CS11)), SETUPDELAY, TIMEOUT, atariPaddlesPot); // CPU/64 @ 12MHz = 187,5KHz, free running
 
 	button_state=button_reported_state=0;
 
@@ -88,29 +270,10 @@ static void atariPaddlesUpdate(void)
 	// Read buttons
 	button_state=(PINB&((1<<PB2)|(1<<PB3)));
 
-	// Read paddles in polling using timer1
-	channel[0]=channel[1]=0;
+	atariPaddlesSaveCalibration();
 
-	for(int i=0;i<2;i++)
-	{
-		wdt_reset();
-		DDRC |= ((1<<(PC0+i)));		// Force port to ground (discharge capacitor)
-		_delay_us(SETUPDELAY);	
-		DDRC &= ~((1<<(PC0+i)));	// Put back port in read mode
-
-		TCNT1=0;					// Reset timer0 value
-		TIFR1|=(1<<TOV1);			// Clear overflow flag
-
-		while((!(PINC&(1<<(PC0+i))))&&!(TIFR1&(1<<TOV1)));	// Wait until pin comes back up. This will correspond to the t=RC 
-															// where R is the value of the POT, thus the position.
-															// or if overflow flow trigged.
-		
-		channel[i]=TCNT1;	// Give channel the timer read.
-		
-		// If disconnected, center paddle
-		if(TIFR1&(1<<TOV1))
-			channel[i]=127*DIVIDER;
-	}
+	// Collect the last measurement and start the next one
+	rcPotPoll();
 }
 
 static char atariPaddlesChanged(char id)
@@ -118,38 +281,25 @@ static char atariPaddlesChanged(char id)
 	return ((button_state != button_reported_state)||(old_channel[0] != channel[0])||(old_channel[1] != channel[1]));		
 }
 
-#define REPORT_SIZE 3
+#define REPORT_SIZE 5
 
 static char atariPaddlesBuildReport(unsigned char *reportBuffer, char id)
 {
-	int x,y;
 	unsigned char tmp;
 
 	if (reportBuffer)
 	{
-		// Calculate the channel value relative to a char (0-255)
-		x=((channel[0])/DIVIDER);
-		y=((channel[1])/DIVIDER);
-
-		// Clipping
-		if(x>255)
-			x=255;
-		else if(x<0)
-			x=0;
-
-		if(y>255)
-			y=255;
-		else if(y<0)
-			y=0;
-
 		tmp=~button_state;
 
-		reportBuffer[0]=255-(char)x; // Invert value
-		reportBuffer[1]=255-(char)y; // Invert value
+		// Channels are already scaled and inverted to 0-PADDLE_MAX
+		reportBuffer[0]=channel[0];
+		reportBuffer[1]=channel[0]>>8;
+		reportBuffer[2]=channel[1];
+		reportBuffer[3]=channel[1]>>8;
 
-		reportBuffer[2] = 0;
-		if (tmp&(1<<PB2)) reportBuffer[2] |= 0x01;	
-		if (tmp&(1<<PB3)) reportBuffer[2] |= 0x02;
+		reportBuffer[4] = 0;
+		if (tmp&(1<<PB2)) reportBuffer[4] |= 0x01;	
+		if (tmp&(1<<PB3)) reportBuffer[4] |= 0x02;
 	}
 
 	button_reported_state=button_state;
@@ -169,8 +319,8 @@ const char atariPaddles_usbHidReportDescriptor[] PROGMEM = {
     0x09, 0x30,                    //     USAGE (X)
     0x09, 0x31,                    //     USAGE (Y)
     0x15, 0x00,                    //     LOGICAL_MINIMUM (0)
-    0x26, 0xff, 0x00,              //     LOGICAL_MAXIMUM (255)
-    0x75, 0x08,                    //     REPORT_SIZE (8)
+    0x26, PADDLE_MAX&0xff, PADDLE_MAX>>8, //     LOGICAL_MAXIMUM (PADDLE_MAX)
+    0x75, 0x10,                    //     REPORT_SIZE (16)
     0x95, 0x02,                    //     REPORT_COUNT (2)
     0x81, 0x02,                    //     INPUT (Data,Var,Abs)
     0x05, 0x09,                    //     USAGE_PAGE (Button)
@@ -0,0 +1,32 @@
+#ifndef _potfilter_h__
+#define _potfilter_h__
+
+/* Integer jitter filter for analog positions
+ *
+ * Median of the last 3 samples drops single spikes, a moving average
+ * (1/2^POTFILTER_SHIFT per sample) smooths what is left and the output
+ * only moves when the average leaves a +/-band window around it, or when
+ * it settles on a new value for POTFILTER_SETTLE samples. A still pot then
+ * reports nothing, while a move larger than POTFILTER_FAST bands skips the
+ * average and is followed at once.
+ *
+ * Samples must stay below 65536>>POTFILTER_SHIFT.
+ */
+
+#define POTFILTER_SHIFT		2
+#define POTFILTER_FAST		4
+#define POTFILTER_SETTLE	8
+
+typedef struct {
+	unsigned int sample[2];		// Two previous samples, for the median
+	unsigned int average;		// Moving average << POTFILTER_SHIFT
+	unsigned int value;			// Filtered output
+	unsigned int band;			// Hysteresis, in sample units
+	unsigned int pending;		// Average waiting to settle inside the band
+	unsigned char settle;
+} PotFilter;
+
+void potFilterInit(PotFilter *f, unsigned int value, unsigned int band);
+unsigned int potFilter(PotFilter *f, unsigned int sample);
+
+#endif // _potfilter_h__
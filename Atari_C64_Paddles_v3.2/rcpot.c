@@ -0,0 +1,254 @@
+/* Asynchronous RC pot measurement engine
+ * Copyright (C) 2020 Francis-Olivier Gradel, B.Eng.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The author may be contacted at info@retronicdesign.com
+ */
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "rcpot.h"
+
+/* Cycle states */
+#define RCPOT_DONE			0	// Results ready, next cycle not started
+#define RCPOT_DISCHARGING	1	// All capacitors held to GND (compare B)
+#define RCPOT_MEASURING		2	// Charging, pin change pots timeout on compare B, comparator pot on compare A
+
+static const RcPot *rc_pots;
+static unsigned char rc_count;
+static unsigned int rc_discharge;
+static unsigned int rc_timeout;
+static void (*rc_done)(unsigned char pot, unsigned int ticks);
+
+static volatile unsigned char rc_state;
+static volatile unsigned char rc_pending;		// Pots still charging, one bit each
+static volatile unsigned char rc_comparator;	// Pot on the comparator, RCPOT_MAX if none
+static volatile unsigned int rc_start;			// Release time of the pin change pots
+static volatile unsigned int rc_comparator_start;
+static volatile unsigned int rc_ticks[RCPOT_MAX];
+static unsigned char rc_pinchange;				// Pin change pots, one bit each
+static unsigned char rc_valid;
+
+static void rcPotCheckDone(void)
+{
+	if (!rc_pending)
+	{
+		TIMSK1 &= ~((1<<OCIE1A)|(1<<OCIE1B));
+		ACSR &= ~(1<<ACIE);
+		rc_state = RCPOT_DONE;
+	}
+}
+
+/* Release the next comparator pot, the others stay discharged */
+static void rcPotNextComparator(void)
+{
+	unsigned char i = rc_comparator;
+
+	ACSR &= ~(1<<ACIE);
+	TIMSK1 &= ~(1<<OCIE1A);
+
+	while (++i < rc_count)
+	{
+		if (rc_pots[i].type == RCPOT_COMPARATOR)
+			break;
+	}
+	rc_comparator = i;
+
+	if (i >= rc_count)
+		return;
+
+	ADMUX = rc_pots[i].mux;
+	ACSR |= (1<<ACI);	// Clear Interrupt Flag. This is needed when pots are disconnected
+	*rc_pots[i].ddr &= ~rc_pots[i].mask;	// Put back port in read mode
+	rc_comparator_start = TCNT1;
+	OCR1A = rc_comparator_start + rc_timeout;
+	TIFR1 = (1<<OCF1A);
+	TIMSK1 |= (1<<OCIE1A);
+	ACSR |= (1<<ACIE);
+}
+
+static void rcPotComparatorDone(unsigned int ticks)
+{
+	rc_ticks[rc_comparator] = ticks;
+	rc_pending &= ~(1<<rc_comparator);
+	rcPotNextComparator();
+	rcPotCheckDone();
+}
+
+ISR(ANALOG_COMP_vect)
+{
+	rcPotComparatorDone(ICR1-rc_comparator_start);	// Triggered timer value
+}
+
+ISR(TIMER1_COMPA_vect)
+{
+	rcPotComparatorDone(RCPOT_TIMEDOUT);
+}
+
+ISR(TIMER1_COMPB_vect)
+{
+	unsigned char i;
+
+	if (rc_state == RCPOT_DISCHARGING)
+	{
+		// Capacitors discharged, release all the pin change pots together
+		rc_state = RCPOT_MEASURING;
+		for (i=0;i<rc_count;i++)
+		{
+			if (rc_pots[i].type == RCPOT_PINCHANGE)
+				*rc_pots[i].pcmsk |= rc_pots[i].mask;
+		}
+		PCIFR = ((1<<PCIF0)|(1<<PCIF1)|(1<<PCIF2));
+		for (i=0;i<rc_count;i++)
+		{
+			if (rc_pots[i].type == RCPOT_PINCHANGE)
+				*rc_pots[i].ddr &= ~rc_pots[i].mask;
+		}
+		rc_start = TCNT1;
+		OCR1B = rc_start + rc_timeout;
+		TIFR1 = (1<<OCF1B);
+		if (!rc_pinchange)
+			TIMSK1 &= ~(1<<OCIE1B);
+
+		rc_comparator = 0xFF;	// Wraps to the first pot
+		rcPotNextComparator();
+	}
+	else
+	{
+		// Timeout of the pin change pots still charging
+		for (i=0;i<rc_count;i++)
+		{
+			if (rc_pots[i].type == RCPOT_PINCHANGE && (rc_pending&(1<<i)))
+			{
+				*rc_pots[i].pcmsk &= ~rc_pots[i].mask;
+				rc_ticks[i] = RCPOT_TIMEDOUT;
+				rc_pending &= ~(1<<i);
+			}
+		}
+		TIMSK1 &= ~(1<<OCIE1B);
+	}
+	rcPotCheckDone();
+}
+
+ISR(PCINT1_vect)
+{
+	unsigned int now = TCNT1;
+	unsigned char i;
+
+	for (i=0;i<rc_count;i++)
+	{
+		if (rc_pots[i].type == RCPOT_PINCHANGE && (rc_pending&(1<<i)) && (*rc_pots[i].pin&rc_pots[i].mask))
+		{
+			*rc_pots[i].pcmsk &= ~rc_pots[i].mask;
+			rc_ticks[i] = now-rc_start;	// t=RC where R is the value of the POT, thus the position.
+			rc_pending &= ~(1<<i);
+		}
+	}
+
+	if (!(rc_pending&rc_pinchange))
+		TIMSK1 &= ~(1<<OCIE1B);	// All pin change pots done, no timeout needed
+	rcPotCheckDone();
+}
+
+ISR(PCINT0_vect, ISR_ALIASOF(PCINT1_vect));
+ISR(PCINT2_vect, ISR_ALIASOF(PCINT1_vect));
+
+static void rcPotStart(void)
+{
+	unsigned char i, sreg;
+
+	rc_pending = 0;
+	for (i=0;i<rc_count;i++)
+	{
+		*rc_pots[i].ddr |= rc_pots[i].mask;	// Force port to ground (discharge capacitor)
+		rc_pending |= (1<<i);
+	}
+
+	rc_state = RCPOT_DISCHARGING;
+
+	// An interrupt between setting the compare and clearing the flag could
+	// let the match pass and be cleared, stalling for a whole timer wrap.
+	sreg = SREG;
+	cli();
+	TIFR1 = (1<<OCF1B);
+	OCR1B = TCNT1 + rc_discharge;
+	TIMSK1 |= (1<<OCIE1B);
+	SREG = sreg;
+}
+
+void rcPotInit(const RcPot *pots, unsigned char count, unsigned char clock, unsigned int discharge, unsigned int timeout, void (*done)(unsigned char pot, unsigned int ticks))
+{
+	unsigned char i;
+
+	rc_pots = pots;
+	rc_count = count;
+	rc_discharge = discharge;
+	rc_timeout = timeout;
+	rc_done = done;
+	rc_valid = 0;
+	rc_pinchange = 0;
+	rc_state = RCPOT_DONE;
+
+	TCCR1A = 0;
+	TCCR1B = clock;	// Normal mode, free running
+
+	for (i=0;i<count;i++)
+	{
+		rc_ticks[i] = RCPOT_TIMEDOUT;
+
+		if (pots[i].type == RCPOT_COMPARATOR)
+		{
+			ADCSRB |= (1<<ACME);	// Comparator negative input on ADC MUX.
+			ADCSRA &= ~(1<<ADEN);	// ADC off, Comparator on.
+			ACSR |= ((1<<ACBG)|(1<<ACIC)|(1<<ACIS1)); // Comparator positive input on BANDGAP, capture on falling edge
+		}
+		else
+		{
+			rc_pinchange |= (1<<i);
+			*pots[i].pcmsk &= ~pots[i].mask;
+			if (pots[i].pcmsk == &PCMSK0) PCICR |= (1<<PCIE0);
+			if (pots[i].pcmsk == &PCMSK1) PCICR |= (1<<PCIE1);
+			if (pots[i].pcmsk == &PCMSK2) PCICR |= (1<<PCIE2);
+		}
+	}
+}
+
+void rcPotSetTimeout(unsigned int timeout)
+{
+	rc_timeout = timeout;	// Read by the interrupts while measuring, so only set between cycles
+}
+
+char rcPotPoll(void)
+{
+	unsigned char i;
+	char ready = 0;
+
+	// Still measuring, keep the previous values
+	if (rc_state != RCPOT_DONE)
+		return 0;
+
+	// Nothing measured before the first cycle
+	if (rc_valid)
+	{
+		for (i=0;i<rc_count;i++)
+			rc_done(i, rc_ticks[i]);
+		ready = 1;
+	}
+	rc_valid = 1;
+
+	rcPotStart();
+
+	return ready;
+}
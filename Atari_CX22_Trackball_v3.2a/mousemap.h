@@ -0,0 +1,79 @@
+/* Atari CX22 Trackball pin map
+ * Copyright (C) 2021 Francis-Olivier Gradel, B.Eng.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The author may be contacted at info@retronicdesign.com
+ */
+
+#ifndef _mousemap_h__
+#define _mousemap_h__
+
+/* PIN1 = PB0 = Xdir
+ * PIN2 = PB1 = Xmov
+ * PIN3 = PB2 = Ydir
+ * PIN4 = PB3 = Ymov
+ * PIN5 = PC3 = na
+ * PIN6 = PB4 = BUT1
+ * PIN7 = PB5 = VCC
+ * PIN8 = PD7 = GND
+ * PIN9 = PC2 = na
+ */
+
+#define MOUSE_PINS_B	((1<<PB0)|(1<<PB1)|(1<<PB2)|(1<<PB3)|(1<<PB4)|(1<<PB5))
+#define MOUSE_DDR_B		(1<<PB5)
+#define MOUSE_PORT_B	((1<<PB0)|(1<<PB1)|(1<<PB2)|(1<<PB3)|(1<<PB4)|(1<<PB5))
+#define MOUSE_PINS_C	((1<<PC0)|(1<<PC1)|(1<<PC2)|(1<<PC3))
+#define MOUSE_PINS_D	(1<<PD7)
+#define MOUSE_DDR_D		(1<<PD7)
+
+#define MOUSE_PCMSK0	((1<<PCINT1)|(1<<PCINT3))	// Xmov,Ymov
+#define MOUSE_STEP_VECT	PCINT0_vect
+#define MOUSE_STEP_BITS	4
+#define MOUSE_STEP_READ()	(PINB&0x0F)	// Step Format (4 bits): MSB Ymov Ydir Xmov Xdir LSB
+
+#define MOUSE_SCALE		4	// Report units per trackball step, the motion between two steps is interpolated
+#define MOUSE_INTERPOLATE
+
+// Button Format (1 bit): BUT1 on PB4
+#define MOUSE_BUTTONS()	((~PINB>>4)&0x01)
+
+/* The CX22 in trackball mode does not give quadrature but a direction and a
+ * movement line for each axis. There is one step on each rising edge of the
+ * movement line, towards the right or down when the direction line is low.
+ *
+ * QUAD: these steps for both axes at once, indexed by the old and new pins
+ * nibbles: MSB old nibble, new nibble LSB. There is no skipped state here.
+ */
+static const unsigned int QUAD[256] PROGMEM = {
+	/* 0 */ QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 1),QD( 0, 1),QD( 1, 1),QD(-1, 1),QD( 0,-1),QD( 0,-1),QD( 1,-1),QD(-1,-1),
+	/* 1 */ QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 1),QD( 0, 1),QD( 1, 1),QD(-1, 1),QD( 0,-1),QD( 0,-1),QD( 1,-1),QD(-1,-1),
+	/* 2 */ QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 1),QD( 0, 1),QD( 0, 1),QD( 0, 1),QD( 0,-1),QD( 0,-1),QD( 0,-1),QD( 0,-1),
+	/* 3 */ QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 1),QD( 0, 1),QD( 0, 1),QD( 0, 1),QD( 0,-1),QD( 0,-1),QD( 0,-1),QD( 0,-1),
+	/* 4 */ QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 1),QD( 0, 1),QD( 1, 1),QD(-1, 1),QD( 0,-1),QD( 0,-1),QD( 1,-1),QD(-1,-1),
+	/* 5 */ QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 1),QD( 0, 1),QD( 1, 1),QD(-1, 1),QD( 0,-1),QD( 0,-1),QD( 1,-1),QD(-1,-1),
+	/* 6 */ QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 1),QD( 0, 1),QD( 0, 1),QD( 0, 1),QD( 0,-1),QD( 0,-1),QD( 0,-1),QD( 0,-1),
+	/* 7 */ QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 1),QD( 0, 1),QD( 0, 1),QD( 0, 1),QD( 0,-1),QD( 0,-1),QD( 0,-1),QD( 0,-1),
+	/* 8 */ QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),
+	/* 9 */ QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),
+	/* A */ QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),
+	/* B */ QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),
+	/* C */ QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),
+	/* D */ QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),QD( 0, 0),QD( 0, 0),QD( 1, 0),QD(-1, 0),
+	/* E */ QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),
+	/* F */ QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),QD( 0, 0),
+};
+
+#endif // _mousemap_h__
@@ -29,6 +29,17 @@
 
 #define MULT 32	// Spinner sensivity
 
+/* Wheel report modes */
+#define WHEEL_CLIPPED	0	// X axis 0-255, MULT per step, stops at both ends
+#define WHEEL_DIAL		1	// Relative rotation on a Dial usage, every step reported
+#define WHEEL_ANGLE		2	// 16 bits angle wrapping around, ANGLE_STEP per step
+
+#define WHEEL_MODE WHEEL_CLIPPED
+//#define WHEEL_MODE WHEEL_DIAL
+//#define WHEEL_MODE WHEEL_ANGLE
+
+#define ANGLE_STEP 4096	// 16 steps per turn, one turn is the whole range. 1 gives a plain step counter
+
 static char AtariDrivingInit(void);
 static void AtariDrivingUpdate(void);
 static char AtariDrivingChanged(char id);
@@ -38,9 +49,17 @@ static unsigned char last_update_state=0;
 static unsigned char last_reported_state=0;
 
 volatile int wheel_pos;
-static unsigned char spinner, old_spinner;
+static int old_wheel_pos;
+static unsigned int wheel_angle, old_wheel_angle;
+static int wheel_delta;			// Dial steps not reported yet
+static volatile int wheel_count;	// Steps counted by interrupt, not applied yet
+static volatile unsigned char old_spinner;
+static signed char spinner_dir;	// Direction of the last valid step
+static volatile unsigned int spinner_skips;	// Skipped states seen, see the feature report
+
+#define QEM_SKIP	2	// X in the QEM: skipped state, both lines changed at once
 
-int QEM [16] = {0,1,-1,2,-1,0,2,1,1,2,0,-1,2,-1,1,0};               // Quadrature Encoder Matrix
+static const signed char QEM [16] = {0,1,-1,2,-1,0,2,1,1,2,0,-1,2,-1,1,0};               // Quadrature Encoder Matrix
 /* QEM explanation:
  *
  * Quadrature from an Atari driving controller is made of two 90 degree out of phase signals that corresponds to
@@ -83,9 +102,39 @@ int QEM [16] = {0,1,-1,2,-1,0,2,1,1,2,0,-1,2,-1,1,0};               // Quadratur
  *
  *   Previous readed value (A-B 2-bit combinasion)
  *
+ * A X (both signals changed at once) means an edge was missed: it is
+ * counted in spinner_skips and taken as two steps in the direction of the
+ * last valid step (none while still unknown).
  */
 
 
+static unsigned char AtariDrivingSpinner(void)
+{
+	unsigned char pins = ~PINB;
+
+	// Spinner Format (2 bits): MSB XB XA LSB
+	return (((pins&(1<<PB0))<<1)|((pins&(1<<PB1))>>1));
+}
+
+/* The wheel is decoded on every edge of XA or XB, whatever the update rate */
+ISR(PCINT0_vect)
+{
+	unsigned char spinner = AtariDrivingSpinner();
+
+	// Quad Format (4 bits): MSB OldB OldA ActualB ActualA LSB
+	signed char d = QEM[(spinner|(old_spinner<<2))];
+
+	if (d == QEM_SKIP)
+	{
+		spinner_skips++;
+		d = spinner_dir*2;
+	}
+	else if (d)
+		spinner_dir = d;
+	wheel_count += d;
+	old_spinner = spinner; // Old position = new position for next edge.
+}
+
 static char AtariDrivingInit(void)
 {
 
@@ -111,8 +160,16 @@ static char AtariDrivingInit(void)
 	PORTD &= ~((1<<PD7));
 
 	/* Spinner, initial condition */
+	old_spinner = AtariDrivingSpinner();
+	wheel_count = 0;
+	wheel_delta = 0;
+	old_wheel_pos = wheel_pos = 0x80;
+	old_wheel_angle = wheel_angle = 0;
 	AtariDrivingUpdate();
-	wheel_pos=0x80;
+
+	PCMSK0 |= ((1<<PCINT0)|(1<<PCINT1));	// XB and XA
+	PCIFR = (1<<PCIF0);
+	PCICR |= (1<<PCIE0);
 
 	return 0;
 }
@@ -120,16 +177,25 @@ static char AtariDrivingInit(void)
 static void AtariDrivingUpdate(void)
 {
 	int delta;
+	unsigned char sreg;
 
 	last_update_state = (PINB&0x13);
 
-	/* Spinner */
-	spinner =(((~last_update_state&(0x01))<<1)|(~last_update_state&(0x02)>>1));
-	
+	/* Spinner, take the steps counted since the last update. Also called
+	 * from init with interrupts still off, so leave them as they were. */
+	sreg = SREG;
+	cli();
+	delta = wheel_count;
+	wheel_count = 0;
+	SREG = sreg;
+
+#if WHEEL_MODE == WHEEL_DIAL
+	wheel_delta += delta;
+#elif WHEEL_MODE == WHEEL_ANGLE
+	wheel_angle += delta*ANGLE_STEP; // Wraps around, no end stop
+#else
 	// Apply delta displacement from quadrature generated by the spinner.
-	// Quad Format (4 bits): MSB OldB OldA ActualB ActualA LSB
-	delta = (QEM[(spinner|(old_spinner<<2))]*MULT);
-	wheel_pos += delta;
+	wheel_pos += delta*MULT;
 
 	// Clipping min and max position
 	if(wheel_pos>(int)255)
@@ -137,17 +203,19 @@ static void AtariDrivingUpdate(void)
 
 	if(wheel_pos<(int)0)
 		wheel_pos=0;
-
-	old_spinner=spinner; // Old position = new position for next iteration.
-
+#endif
 }
 
 static char AtariDrivingChanged(char id)
 {
-	return (last_update_state != last_reported_state);
+	return ((last_update_state != last_reported_state) || wheel_delta || (wheel_pos != old_wheel_pos) || (wheel_angle != old_wheel_angle));
 }
 
+#if WHEEL_MODE == WHEEL_ANGLE
+#define REPORT_SIZE 3
+#else
 #define REPORT_SIZE 2
+#endif
 
 static char AtariDrivingBuildReport(unsigned char *reportBuffer, char id)
 {
@@ -158,20 +226,48 @@ static char AtariDrivingBuildReport(unsigned char *reportBuffer, char id)
 		tmp = (last_update_state ^ 0xff);
 		
 	   /*
- 		* [0] Wheel_Pos
- 		* [1] Fire
+ 		* [0] Wheel_Pos, Dial or Angle low
+ 		* [1] Angle high (WHEEL_ANGLE)
+ 		* [n] Fire
  		*/
-		
+
+#if WHEEL_MODE == WHEEL_DIAL
+		int delta = wheel_delta;
+		if (delta > 127)
+			delta = 127;
+		if (delta < -127)
+			delta = -127;
+		wheel_delta -= delta; // What does not fit goes with the next report
+
+		reportBuffer[0] = (unsigned char)delta;
+#elif WHEEL_MODE == WHEEL_ANGLE
+		reportBuffer[0] = wheel_angle;
+		reportBuffer[1] = wheel_angle>>8;
+#else
 		reportBuffer[0] = (unsigned char)wheel_pos;
-		reportBuffer[1] = 0;
+#endif
+		reportBuffer[REPORT_SIZE-1] = 0;
 
-		if (tmp&(1<<PB4)) reportBuffer[1] |= 0b00000001;	//fire
+		if (tmp&(1<<PB4)) reportBuffer[REPORT_SIZE-1] |= 0b00000001;	//fire
 	}
 	last_reported_state = last_update_state;
+	old_wheel_pos = wheel_pos;
+	old_wheel_angle = wheel_angle;
 
 	return REPORT_SIZE;
 }
 
+/* Feature report: skipped quadrature states, for diagnostics */
+static char AtariDrivingBuildFeature(unsigned char *reportBuffer)
+{
+	cli();
+	reportBuffer[0] = spinner_skips;
+	reportBuffer[1] = spinner_skips>>8;
+	sei();
+
+	return 2;
+}
+
 const char AtariDriving_usbHidReportDescriptor[] PROGMEM = {
 
     0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)
@@ -179,12 +275,28 @@ const char AtariDriving_usbHidReportDescriptor[] PROGMEM = {
     0xa1, 0x01,                    // COLLECTION (Application)
     0x09, 0x01,                    //   USAGE (Pointer)
     0xa1, 0x00,                    //   COLLECTION (Physical)
+#if WHEEL_MODE == WHEEL_DIAL
+    0x09, 0x37,                    //     USAGE (Dial)
+    0x15, 0x81,                    //     LOGICAL_MINIMUM (-127)
+    0x25, 0x7f,                    //     LOGICAL_MAXIMUM (127)
+    0x75, 0x08,                    //     REPORT_SIZE (8)
+    0x95, 0x01,                    //     REPORT_COUNT (1)
+    0x81, 0x06,                    //     INPUT (Data,Var,Rel)
+#elif WHEEL_MODE == WHEEL_ANGLE
+    0x09, 0x30,                    //     USAGE (X)
+    0x15, 0x00,                    //     LOGICAL_MINIMUM (0)
+    0x27, 0xff, 0xff, 0x00, 0x00,  //     LOGICAL_MAXIMUM (65535)
+    0x75, 0x10,                    //     REPORT_SIZE (16)
+    0x95, 0x01,                    //     REPORT_COUNT (1)
+    0x81, 0x22,                    //     INPUT (Data,Var,Abs,Wrap)
+#else
     0x09, 0x30,                    //     USAGE (X)
     0x15, 0x00,                    //     LOGICAL_MINIMUM (0)
     0x26, 0xff, 0x00,              //     LOGICAL_MAXIMUM (255)
     0x75, 0x08,                    //     REPORT_SIZE (8)
     0x95, 0x01,                    //     REPORT_COUNT (1)
     0x81, 0x02,                    //     INPUT (Data,Var,Abs)
+#endif
     0xc0,                          // END_COLLECTION
     0x05, 0x09,                    // USAGE_PAGE (Button)
     0x19, 0x01,                    //   USAGE_MINIMUM (Button 1)
@@ -198,7 +310,7 @@ const char AtariDriving_usbHidReportDescriptor[] PROGMEM = {
     0x15, 0x00,         //          LOGICAL_MINIMUM (0)
     0x26, 0xff, 0x00,   //          LOGICAL_MAXIMUM (255)
     0x75, 0x08,         //          REPORT_SIZE (8)
-    0x95, 0x01,         //          REPORT_COUNT (1)
+    0x95, 0x02,         //          REPORT_COUNT (2) // GET FEATURE: skipped states (16 bits)
     0xb2, 0x02, 0x01,   //          FEATURE (Data,Var,Abs,Buf)	
     0xc0                           // END_COLLECTION
 };
@@ -232,6 +344,7 @@ Gamepad AtariDrivingJoy = {
 	.update					=	AtariDrivingUpdate,
 	.changed				=	AtariDrivingChanged,
 	.buildReport			=	AtariDrivingBuildReport,
+	.buildFeature			=	AtariDrivingBuildFeature,
 };
 
 Gamepad *AtariDrivingGetGamepad(void)
@@ -181,6 +181,8 @@ uchar	usbFunctionSetup(uchar data[8])
 		{
 			case USBRQ_HID_GET_REPORT:
 				/* wValue: ReportType (highbyte), ReportID (lowbyte) */
+				if (rq->wValue.bytes[1] == 3 && curGamepad->buildFeature)
+					return curGamepad->buildFeature(setupBuffer);
 				return curGamepad->buildReport(setupBuffer, rq->wValue.bytes[0]);
 
 			case USBRQ_HID_SET_REPORT:
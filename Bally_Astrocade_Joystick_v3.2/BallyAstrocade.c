@@ -26,23 +26,44 @@
 #include <string.h>
 #include "usbconfig.h"
 #include "BallyAstrocade.h"
+#include "rcpot.h"
+#include "potfilter.h"
 
-#define SETUPDELAY	7//5
+#define SETUPDELAY	11	// Time to reset the capacitor back to GND (timer1 ticks, 7uS)
 #define DIVIDER 4 // 50K pot
-#define TIMEOUT	65000
+#define TIMEOUT	1300	// Past full scale (255*DIVIDER), no pot
 
 static char BallyAstrocadeInit(void);
 static void BallyAstrocadeUpdate(void);
 static char BallyAstrocadeChanged(char id);
 static char BallyAstrocadeBuildReport(unsigned char *reportBuffer, char id);
-static void BallyAstrocadeReadPot(void);
 
-volatile unsigned int pot,old_pot;
-volatile char flag;
+volatile unsigned int pot,old_pot;	// Filtered position, 0-255
+static PotFilter filter;
+
+static const RcPot pots[1] = {
+	{ RCPOT_COMPARATOR, &DDRC, &PINC, 0, (1<<PC0), 0 },
+};
 
 static unsigned char last_update_state=0;
 static unsigned char last_reported_state=0;
 
+static void BallyAstrocadePot(unsigned char i, unsigned int ticks)
+{
+	// Not connected, keep the last value
+	if (ticks == RCPOT_TIMEDOUT)
+		return;
+
+	// Re-rangeing the pot values between 0-255
+	ticks/=DIVIDER;
+
+	// Clip maximum value to 255
+	if(ticks>255)
+		ticks=255;
+
+	pot=potFilter(&filter, ticks);
+}
+
 static char BallyAstrocadeInit(void)
 {
 
@@ -70,26 +91,19 @@ static char BallyAstrocadeInit(void)
 	PORTC |= (1<<PC3);
 
 	old_pot=pot=0;
+	potFilterInit(&filter, 0, 1);
 
-	ADCSRB |= (1<<ACME);	// Comparator negative input on ADC MUX.
-	ADCSRA &= ~(1<<ADEN);	// ADC off, Comparator on.
-	ACSR |= ((1<<ACBG)|(1<<ACIE)|(1<<ACIC)|(1<<ACIS1)); // Comparator positive input on BANDGAP. Interrupt enable on caparator
-	ADMUX=0; // Channel 0 selected (PC0)
-
-	TCCR1B |= ((1<<WGM12)|(1<<CS11));	// Timer1: CTC,XTAL/8
+	rcPotInit(pots, 1, (1<<CS11), SETUPDELAY, TIMEOUT, BallyAstrocadePot);	// Timer1: free running, XTAL/8
 
 	return 0;
 }
 
 static void BallyAstrocadeUpdate(void)
 {
-	unsigned int i=0;
-
 	last_update_state = ((PINB&((1<<PB1)|(1<<PB2)|(1<<PB3)|(1<<PB4))) | ((PINC&(1<<PC3))>>3));
-	BallyAstrocadeReadPot();
 
-	while(i<TIMEOUT && flag)
-		i++;
+	// Collect the last measurement and start the next one
+	rcPotPoll();
 }
 
 static char BallyAstrocadeChanged(char id)
@@ -108,15 +122,8 @@ static char BallyAstrocadeBuildReport(unsigned char *reportBuffer, char id)
 	{
 		y = x = 0x80;
 
-		// Re-rangeing the pot values between 0-255
-		z=(pot/DIVIDER);
-
-		// Clip maximum value to 255
-		if(z>255)
-			z=255;
-		
 		// Inverting pot values (cw to ccw)
-		z=255-z;
+		z=255-pot;
 
 		tmp = last_update_state ^ 0xff;
 
@@ -133,6 +140,7 @@ static char BallyAstrocadeBuildReport(unsigned char *reportBuffer, char id)
 
 	}
 	last_reported_state = last_update_state;
+	old_pot = pot;
 
 	return REPORT_SIZE;
 }
@@ -208,19 +216,3 @@ Gamepad *BallyAstrocadeGetGamepad(void)
 
 	return &BallyAstrocadeJoy;
 }
-
-ISR(ANALOG_COMP_vect)
-{
-	pot=ICR1;		// Store triggered timer value 
-	flag=0;			// Lower reading in process flag.
-}
-
-void BallyAstrocadeReadPot(void)
-{
-	flag=1;	// Read in process flag
-	DDRC |= (1<<PC0);	// Force port to ground
-	_delay_us(SETUPDELAY);	// Wait for capacitor to be discharged
-	DDRC &= ~(1<<PC0);	// Put back port in read mode (floating);
-	TCNT1=0;// Clear counter value
-}
-
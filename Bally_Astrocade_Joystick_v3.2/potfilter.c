@@ -0,0 +1,88 @@
+/* Integer jitter filter for analog positions
+ * Copyright (C) 2020 Francis-Olivier Gradel, B.Eng.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The author may be contacted at info@retronicdesign.com
+ */
+#include "potfilter.h"
+
+static unsigned int potFilterMedian(unsigned int a, unsigned int b, unsigned int c)
+{
+	unsigned int t;
+
+	if (a > b)
+	{
+		t = a;
+		a = b;
+		b = t;
+	}
+
+	if (c <= a)
+		return a;
+	if (c >= b)
+		return b;
+	return c;
+}
+
+static unsigned int potFilterDistance(unsigned int a, unsigned int b)
+{
+	return (a > b) ? a-b : b-a;
+}
+
+void potFilterInit(PotFilter *f, unsigned int value, unsigned int band)
+{
+	f->sample[0] = f->sample[1] = value;
+	f->average = value<<POTFILTER_SHIFT;
+	f->value = f->pending = value;
+	f->band = band;
+	f->settle = 0;
+}
+
+unsigned int potFilter(PotFilter *f, unsigned int sample)
+{
+	unsigned int median = potFilterMedian(f->sample[0], f->sample[1], sample);
+	unsigned int average = f->average>>POTFILTER_SHIFT;
+
+	f->sample[0] = f->sample[1];
+	f->sample[1] = sample;
+
+	// Real motion, no need to average it
+	if (potFilterDistance(median, average) > f->band*POTFILTER_FAST)
+		f->average = median<<POTFILTER_SHIFT;
+	else
+		f->average += median-average;	// Wraps correctly, average stays in range
+
+	average = f->average>>POTFILTER_SHIFT;
+
+	if (potFilterDistance(average, f->value) > f->band)
+	{
+		f->value = f->pending = average;
+		f->settle = 0;
+	}
+	else if (average != f->pending)
+	{
+		// Inside the band, only a steady average gets through
+		f->pending = average;
+		f->settle = 0;
+	}
+	else if (average != f->value && ++f->settle >= POTFILTER_SETTLE)
+	{
+		f->value = average;
+		f->settle = 0;
+	}
+
+	return f->value;
+}
@@ -34,6 +34,20 @@ static char CD32BuildReport(unsigned char *reportBuffer, char id);
 static unsigned int last_update_state=0;
 static unsigned int last_reported_state=0;
 
+/* The pad's shift register answers within a microsecond, these leave margin
+ * for long cables and the weak pull-ups.
+ */
+#define CD32_SETTLE_US		10	// LOAD low to first bit valid
+#define CD32_CLK_US			3	// Half period of the shift clock
+
+/* A plain joystick is re-probed every 64 samples (~1s at 60 Hz) */
+#define CD32_PROBE_INTERVAL	64
+
+static unsigned char cd32_present=0;
+static unsigned char probe_counter=0;
+
+static unsigned int CD32ShiftRead(void);
+
 static char CD32Init(void)
 {
 	/* PB0   = PIN1 = UP 	(I,1)
@@ -59,12 +73,59 @@ static char CD32Init(void)
 	DDRD |= (1<<PD7);
 	PORTD &= ~(1<<PD7);
 
+	_delay_us(100);
+
+	cd32_present = ((CD32ShiftRead()&0x180) == 0x080);
+	probe_counter = 0;
+
 	return 0;
 }
 
+/* Returns the 9 bits shifted out by the pad, raw levels (buttons active low).
+ * A CD32 pad sends its 7 buttons followed by a 1 then a 0, a plain joystick
+ * leaves DATA pulled up. The port is put back in normal mode on return.
+ */
+static unsigned int CD32ShiftRead(void)
+{
+	unsigned char bit;
+	unsigned int data = 0;
+
+	/* Scanning Mode *********************/
+	/* PB0 = UP (IN, 1)
+	 * PB1 = DOWN (IN, 1)
+	 * PB2 = LEFT (IN,1 )
+	 * PB3 = RIGHT (IN, 1)
+	 * PB4 = CLK (OUT, 1)
+	 * PC2 = DATA (IN, 1)
+	 * PC3 = SHIFT (OUT, 0) 
+	 */
+
+	DDRB |= (1<<PB4); // CLK=1
+	DDRC |= (1<<PC3);
+	PORTC &= ~(1<<PC3); // SHIFT = 0
+
+	_delay_us(CD32_SETTLE_US);
+
+	for(bit=0;bit<9;bit++)
+	{
+		PORTB &= ~(1<<PB4);	// CLK=0
+		_delay_us(CD32_CLK_US);
+		if (PINC&(1<<PC2)) data |= (1<<bit);
+		PORTB |= (1<<PB4);	// CLK=1
+		_delay_us(CD32_CLK_US);
+	}
+
+	/* Back to Normal Mode, CLK and SHIFT as inputs with pull-up */
+	PORTC |= (1<<PC3);
+	DDRC &= ~(1<<PC3);
+	DDRB &= ~(1<<PB4);
+
+	return data;
+}
+
 static void CD32Update(void)
 {
-	unsigned char button;
+	unsigned int data;
 
 	/* Normal Mode ***********************/
 	/* PB0 = UP (IN, 1)
@@ -74,50 +135,30 @@ static void CD32Update(void)
 	 * PB4 = BUT RED (IN, 1)
 	 * PC2 = BUT BLUE (IN, 1)
 	 * PC3 = LOAD  (IN, 1, in case of std joystick, discarded though)
+	 *
+	 * The port is always left in this mode, no settling needed.
 	 */
-	
-	DDRB &= ~((1<<PB0)|(1<<PB1)|(1<<PB2)|(1<<PB3)|(1<<PB4));
-	PORTB |= ((1<<PB0)|(1<<PB1)|(1<<PB2)|(1<<PB3)|(1<<PB4));
-
-	DDRC &= ~((1<<PC0)|(1<<PC1)|(1<<PC2)|(1<<PC3));
-	PORTC |= ((1<<PC0)|(1<<PC1)|(1<<PC2)|(1<<PC3));
-
-	_delay_us(100);
 
-	last_update_state = 0x0000 | (unsigned int)(PINB&0x1F) | (unsigned int)((PINC&0x04)<<3);
+	last_update_state = 0x7F00 | (unsigned int)(PINB&0x1F) | (unsigned int)((PINC&0x04)<<3);
 	/* last_update state format:
 	 * 
 	 * 15 14    13         12          11    10     9   8    7 6 5    4   3     2    1    0
 	 * 0  PAUSE LEFT_FRONT RIGHT_FRONT GREEN YELLOW RED BLUE X X BLUE RED RIGHT LEFT DOWN UP
 	 */
 
-	/* Scanning Mode *********************/
-	/* PB0 = UP (IN, 1)
-	 * PB1 = DOWN (IN, 1)
-	 * PB2 = LEFT (IN,1 )
-	 * PB3 = RIGHT (IN, 1)
-	 * PB4 = CLK (OUT, 1)
-	 * PC2 = DATA (IN, 0)
-	 * PC3 = SHIFT (OUT, 0) 
+	/* Plain joysticks skip the shift sequence, only probing now and then
+	 * in case a CD32 pad was plugged in.
 	 */
-	
-	DDRB &= ~((1<<PB0)|(1<<PB1)|(1<<PB2)|(1<<PB3));
-	DDRC &= ~((1<<PC2));
+	if (!cd32_present && ++probe_counter < CD32_PROBE_INTERVAL)
+		return;
 
-	DDRB |= (1<<PB4);
-	DDRC |= (1<<PC3);
+	probe_counter = 0;
 
-	PORTB |= ((1<<PB0)|(1<<PB1)|(1<<PB2)|(1<<PB3)|(1<<PB4)); // CLK=1
-	PORTC &= ~((1<<PC2)|(1<<PC3)); // SHIFT = 0, DATA = HI-Z
+	data = CD32ShiftRead();
+	cd32_present = ((data&0x180) == 0x080);
 
-	for(button=0;button<7;button++)
-	{
-		_delay_us(100);
-		PORTB &= ~(1<<PB4);	// CLK=0
-		_delay_us(100);
-		last_update_state |= (((PINC&(1<<PC2))?1:0)<<(button+8));
-		PORTB |= (1<<PB4);	// CLK=1
-	}
+	if (cd32_present)
+		last_update_state = (last_update_state&0x00FF) | ((data&0x7F)<<8);
 }
 
 static char CD32Changed(char id)
@@ -27,6 +27,14 @@
 #include "usbconfig.h"
 #include "colecovision.h"
 
+/* Sub controllers are read one per update: the select lines are switched
+ * at the end of a tick and read on the next one, ~1ms later. The lines only
+ * need a few RC constants of the pull-ups and cable to settle (~50uS worst
+ * case), so no update ever waits on them.
+ */
+#define SELECT_1	0	// Joystick & fire button
+#define SELECT_2	1	// Keypad & arm button
+
 static char colecovisionInit(void);
 static void colecovisionUpdate(void);
 static char colecovisionChanged(char id);
@@ -34,6 +42,23 @@ static char colecovisionBuildReport(unsigned char *reportBuffer, char id);
 
 static unsigned char last_update_state[2]={0,0};
 static unsigned char last_reported_state[2]={0,0};
+static unsigned char selected;
+
+static void colecovisionSelect(unsigned char sub)
+{
+	if (sub == SELECT_1)
+	{
+		PORTB |= (1<<PB0); // Sub controller 1 selected
+		PORTB &= ~((1<<PB2));
+	}
+	else
+	{
+		PORTB &= ~(1<<PB0); // Sub controller 2 selected
+		PORTB |= ((1<<PB2));
+	}
+
+	selected = sub;
+}
 
 static char colecovisionInit(void)
 {
@@ -74,6 +99,8 @@ static char colecovisionInit(void)
 	DDRD &= ~(1<<PD7);
 	PORTD |= ((1<<PD7));
 
+	colecovisionSelect(SELECT_1);
+
 	return 0;
 }
 
@@ -83,21 +110,12 @@ static char colecovisionInit(void)
 
 static void colecovisionUpdate(void)
 {
-	PORTB |= (PB0); // Sub controller 1 selected
-	PORTB &= ~((1<<PB2));
-
-	_delay_ms(2);
-
 	// Complex reading arrangement only to fit original controller decoding //
-	last_update_state[0] = ((PINB&0x02)>>1)|((PINB&0x30)>>2)|((PINC&(1<<PC3))>>2)|((PIND&(1<<PD7))>>3);
-
-	PORTB &= ~(PB0); // Sub controller 2 selected
-	PORTB |= ((1<<PB2));
+	unsigned char state = ((PINB&0x02)>>1)|((PINB&0x30)>>2)|((PINC&(1<<PC3))>>2)|((PIND&(1<<PD7))>>3);
 
-	_delay_ms(2);
-
-	// Complex reading arrangement only to fit original controller decoding //
-	last_update_state[1] = ((PINB&0x02)>>1)|((PINB&0x30)>>2)|((PINC&(1<<PC3))>>2)|((PIND&(1<<PD7))>>3);
+	// Store the sub controller selected on the previous tick, select the other one
+	last_update_state[selected] = state;
+	colecovisionSelect(selected == SELECT_1 ? SELECT_2 : SELECT_1);
 
 }
 
@@ -22,12 +22,21 @@
 #include <avr/io.h>
 #include <util/delay.h>
 #include <avr/pgmspace.h>
+#include <avr/interrupt.h>
 #include <string.h>
 #include "usbconfig.h"
 #include "colecovision.h"
 
 #define MULT 32	// Spinner sensitivity
 
+/* Sub controllers are read one per update: the select lines are switched
+ * at the end of a tick and read on the next one, ~1ms later. The lines only
+ * need a few RC constants of the pull-ups and cable to settle (~50uS worst
+ * case), so no update ever waits on them.
+ */
+#define SELECT_1	0	// Joystick & fire button
+#define SELECT_2	1	// Keypad & arm button
+
 static char colecovisionInit(void);
 static void colecovisionUpdate(void);
 static char colecovisionChanged(char id);
@@ -35,11 +44,18 @@ static char colecovisionBuildReport(unsigned char *reportBuffer, char id);
 
 static unsigned char last_update_state[2]={0,0};
 static unsigned char last_reported_state[2]={0,0};
+static unsigned char selected;
 
 volatile int wheel_pos;
-static unsigned char spinner, old_spinner;
+static int old_wheel_pos;
+static volatile int spinner_count;	// Quadrature steps counted by interrupt, not yet applied
+static volatile unsigned char old_spinner;
+static signed char spinner_dir;	// Direction of the last valid step
+static volatile unsigned int spinner_skips;	// Skipped states seen, see the feature report
+
+#define QEM_SKIP	2	// X in the QEM: skipped state, both lines changed at once
 
-int QEM [16] = {0,1,-1,2,-1,0,2,1,1,2,0,-1,2,-1,1,0};               // Quadrature Encoder Matrix
+static const signed char QEM [16] = {0,1,-1,2,-1,0,2,1,1,2,0,-1,2,-1,1,0};               // Quadrature Encoder Matrix
 /* QEM explanation:
  *
  * Quadrature from a Coleco spinner is made of two 90 degree out of phase signals that corresponds to
@@ -82,9 +98,28 @@ int QEM [16] = {0,1,-1,2,-1,0,2,1,1,2,0,-1,2,-1,1,0};               // Quadratur
  *
  *   Previous read value (A-B 2-bit combination)
  *
+ * A X (both signals changed at once) means an edge was missed: it is
+ * counted in spinner_skips and taken as two steps in the direction of the
+ * last valid step (none while still unknown).
  */
 
 
+static void colecovisionSelect(unsigned char sub)
+{
+	if (sub == SELECT_1)
+	{
+		PORTC |= ((1<<PC1)|(1<<PC3)); // Sub controller 1 selected
+		PORTD &= ~((1<<PD7));
+	}
+	else
+	{
+		PORTC &= ~((1<<PC1)|(1<<PC3)); // Sub controller 2 selected
+		PORTD |= ((1<<PD7));
+	}
+
+	selected = sub;
+}
+
 static char colecovisionInit(void)
 {
 
@@ -111,38 +146,67 @@ static char colecovisionInit(void)
 	DDRD |= (1<<PD7);
 	PORTD &= ~((1<<PD7));
 
+	colecovisionSelect(SELECT_1);
+
 	/* Spinner, initial condition */
-	colecovisionUpdate();
-	wheel_pos=0x80;
+	old_spinner = ((~PINB&(1<<PB5))>>5) | ((~PINC&(1<<PC2))>>1);
+	spinner_count=0;
+	old_wheel_pos=wheel_pos=0x80;
+
+	// Quadrature A on PB5 (PCINT5), B on PC2 (PCINT10)
+	PCMSK0 |= (1<<PCINT5);
+	PCMSK1 |= (1<<PCINT10);
+	PCIFR = ((1<<PCIF0)|(1<<PCIF1));
+	PCICR |= ((1<<PCIE0)|(1<<PCIE1));
 
 	return 0;
 }
 
-static void colecovisionUpdate(void)
+/* Spinner decoding runs on every edge of A or B, whatever the sample rate */
+ISR(PCINT0_vect)
 {
-	int delta;
+	unsigned char spinner = ((~PINB&(1<<PB5))>>5) | ((~PINC&(1<<PC2))>>1);
 
-	PORTC |= ((1<<PC1)|(1<<PC3)); // Sub controller 1 selected
-	PORTD &= ~((1<<PD7));
+	// Quad Format (4 bits): MSB OldB OldA ActualB ActualA LSB
+	signed char d = QEM[(spinner|(old_spinner<<2))];
 
-	_delay_ms(2);
+	if (d == QEM_SKIP)
+	{
+		spinner_skips++;
+		d = spinner_dir*2;
+	}
+	else if (d)
+		spinner_dir = d;
+	spinner_count += d;
+	old_spinner=spinner; // Old position = new position for next edge.
+}
 
-	last_update_state[0] = (PINB&0x3F);
+ISR(PCINT1_vect, ISR_ALIASOF(PCINT0_vect));
 
-	PORTC &= ~((1<<PC1)|(1<<PC3)); // Sub controller 2 selected
-	PORTD |= ((1<<PD7));
+static void colecovisionUpdate(void)
+{
+	int delta;
 
-	_delay_ms(2);
+	// Read the sub controller selected on the previous tick, select the other one
+	if (selected == SELECT_1)
+	{
+		last_update_state[0] = (PINB&0x3F);
+		colecovisionSelect(SELECT_2);
+	}
+	else
+	{
+		last_update_state[1] = ((PINB&0x1F)|((PINC&(1<<PC2))<<3));
+		colecovisionSelect(SELECT_1);
+	}
 
-	last_update_state[1] = ((PINB&0x1F)|((PINC&(1<<PC2))<<3));
+	/* Spinner, take the steps counted since the last update */
+	cli();
+	delta = spinner_count;
+	spinner_count = 0;
+	sei();
 
-	/* Spinner */
-	spinner = ((~last_update_state[0]&(1<<PB5))>>5) | ((~last_update_state[1]&(1<<PB5))>>4);
-	
 	// Apply delta displacement from quadrature generated by the spinner.
-	// Quad Format (4 bits): MSB OldB OldA ActualB ActualA LSB
-	delta = (QEM[(spinner|(old_spinner<<2))]*MULT);
-	wheel_pos += delta;
+	wheel_pos += delta*MULT;
 
 	// Clipping min and max position
 	if(wheel_pos>(int)255)
@@ -150,14 +214,11 @@ static void colecovisionUpdate(void)
 
 	if(wheel_pos<(int)0)
 		wheel_pos=0;
-
-	old_spinner=spinner; // Old position = new position for next iteration.
-
 }
 
 static char colecovisionChanged(char id)
 {
-	return (last_update_state[0] != last_reported_state[0] || last_update_state[1] != last_reported_state[1]);
+	return (last_update_state[0] != last_reported_state[0] || last_update_state[1] != last_reported_state[1] || wheel_pos != old_wheel_pos);
 }
 
 #define REPORT_SIZE 5
@@ -224,10 +285,22 @@ static char colecovisionBuildReport(unsigned char *reportBuffer, char id)
 
 	last_reported_state[0] = last_update_state[0];
 	last_reported_state[1] = last_update_state[1];
+	old_wheel_pos = wheel_pos;
 
 	return REPORT_SIZE;
 }
 
+/* Feature report: skipped quadrature states, for diagnostics */
+static char colecovisionBuildFeature(unsigned char *reportBuffer)
+{
+	cli();
+	reportBuffer[0] = spinner_skips;
+	reportBuffer[1] = spinner_skips>>8;
+	sei();
+
+	return 2;
+}
+
 const char colecovision_usbHidReportDescriptor[] PROGMEM = {
 
     0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)
@@ -255,7 +328,7 @@ const char colecovision_usbHidReportDescriptor[] PROGMEM = {
     0x15, 0x00,					   //     LOGICAL_MINIMUM (0)
     0x26, 0xff, 0x00,			   //     LOGICAL_MAXIMUM (255)
     0x75, 0x08,					   //     REPORT_SIZE (8)
-    0x95, 0x01,					   //     REPORT_COUNT (1)
+    0x95, 0x02,					   //     REPORT_COUNT (2) // GET FEATURE: skipped states (16 bits)
     0xb2, 0x02, 0x01,			   //     FEATURE (Data,Var,Abs,Buf)
 	0xc0,                          //   END_COLLECTION	
     0xc0                           // END_COLLECTION
@@ -290,6 +363,7 @@ Gamepad colecovisionJoy = {
 	.update					=	colecovisionUpdate,
 	.changed				=	colecovisionChanged,
 	.buildReport			=	colecovisionBuildReport,
+	.buildFeature			=	colecovisionBuildFeature,
 };
 
 Gamepad *colecovisionGetGamepad(void)
@@ -21,6 +21,12 @@ typedef struct {
 	 * return The number of bytes written to buf
 	 */
 	char (*buildReport)(unsigned char *buf, char id);
+
+	/**
+	 * \brief Optional, feature report returned on GET_REPORT (Feature)
+	 * return The number of bytes written to buf
+	 */
+	char (*buildFeature)(unsigned char *buf);
 } Gamepad;
 
 #endif // _gamepad_h__
@@ -128,10 +128,10 @@ static void hardwareInit(void)
 	/* configure timer 0 for a rate of 12M/(1024 * 256) = 45.78 Hz (~22ms) */
 	TCCR0B = (1<<CS02)|(1<<CS00);
 
-	/* configure timer 2 for a rate of 12M/(1024 * 196) = 59.79 Hz (~16.7ms) */
+	/* configure timer 2 for a rate of 12M/(1024 * (11+1)) = 976.56 Hz (~1ms) */
 	TCCR2A = (1<<WGM21);
 	TCCR2B = (1<<CS22)|(1<<CS21)|(1<<CS20);
-	OCR2A = 49;// for 240 hz
+	OCR2A = 11;// for ~1 khz, one sub controller per tick
 }
 
 static uchar    reportBuffer[6];    /* buffer for HID reports */
@@ -181,6 +181,8 @@ uchar	usbFunctionSetup(uchar data[8])
 		{
 			case USBRQ_HID_GET_REPORT:
 				/* wValue: ReportType (highbyte), ReportID (lowbyte) */
+				if (rq->wValue.bytes[1] == 3 && curGamepad->buildFeature)
+					return curGamepad->buildFeature(setupBuffer);
 				return curGamepad->buildReport(setupBuffer, rq->wValue.bytes[0]);
 
 			case USBRQ_HID_SET_REPORT:
@@ -0,0 +1,378 @@
+/* ColecoVision "Roller Controller" seen as a mouse to USB (interrupt version)
+ * Copyright (C) 2021 Francis-Olivier Gradel, B.Eng.
+ *
+ * Using V-USB code from OBJECTIVE DEVELOPMENT Software GmbH. http://www.obdev.at/products/vusb/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The author may be contacted at info@retronicdesign.com
+ */
+
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include <avr/interrupt.h>  /* for sei() */
+#include <util/delay.h>     /* for _delay_ms() */
+#include <avr/pgmspace.h>   /* required by usbdrv.h */
+#include "usbdrv.h"
+
+#include "../bootloader/fuses.h"
+#include "../bootloader/bootloader.h"
+
+#define MULT	4	// Trackball sensitivity
+#define MAX_COUNT	(32767/MULT)	// Quadrature steps fitting in one report
+
+unsigned char jumptobootloader;
+
+static void RollerInit(void);
+static void RollerUpdate(void);
+static char UpdateReportBuffer(void);
+
+static volatile int count_x;	// Quadrature steps counted by interrupt, not yet reported
+static volatile int count_y;
+static volatile unsigned char old_quad;
+static unsigned char buttons;
+static unsigned char reported_buttons;
+static unsigned char selected;
+
+static const signed char QEM [16] = {0,1,-1,2,-1,0,2,1,1,2,0,-1,2,-1,1,0};               // Quadrature Encoder Matrix
+/* QEM explanation:
+ *
+ * Each axis of the Roller Controller is a spinner like the Super Action
+ * Controller one: two 90 degree out of phase signals, A and B, from the
+ * spinner lines of a controller port (see ColecoVision_Controller_v3.2).
+ *
+ *        Actual read value (B-A 2-bit combination)
+ *        0   1   2   3
+ *     ----------------
+ *   0 |  0   1  -1   X
+ *
+ *   1 | -1   0   X   1
+ *
+ *   2 |  1   X   0  -1
+ *
+ *   3 |  X  -1   1   0
+ *
+ *   Previous read value (B-A 2-bit combination)
+ *
+ * A X (both signals changed at once) means an edge was missed, see
+ * QuadStep().
+ */
+
+#define QEM_SKIP	2	// X in the QEM: skipped state, both lines changed at once
+
+/* A skipped state means an edge was missed. It is counted, and taken as two
+ * steps in the direction of the last valid step (none while still unknown).
+ */
+static signed char dir_x, dir_y;	// Direction of the last valid step
+static volatile unsigned int skip_x, skip_y;	// Skipped states seen, see the diagnostics feature report
+
+static inline signed char QuadStep(signed char d, signed char *dir, volatile unsigned int *skips)
+{
+	if (d == QEM_SKIP)
+	{
+		(*skips)++;
+		return *dir*2;
+	}
+	if (d)
+		*dir = d;
+	return d;
+}
+
+/* ------------------------------------------------------------------------- */
+/* ----------------------------- USB interface ----------------------------- */
+/* ------------------------------------------------------------------------- */
+
+PROGMEM const char usbHidReportDescriptor[66] = { /* USB report descriptor, size must match usbconfig.h */
+    0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)
+    0x09, 0x02,                    // USAGE (Mouse)
+    0xa1, 0x01,                    // COLLECTION (Application)
+    0x09, 0x01,                    //   USAGE (Pointer)
+    0xA1, 0x00,                    //   COLLECTION (Physical)
+    0x05, 0x09,                    //     USAGE_PAGE (Button)
+    0x19, 0x01,                    //     USAGE_MINIMUM
+    0x29, 0x02,                    //     USAGE_MAXIMUM
+    0x15, 0x00,                    //     LOGICAL_MINIMUM (0)
+    0x25, 0x01,                    //     LOGICAL_MAXIMUM (1)
+    0x95, 0x02,                    //     REPORT_COUNT (2)
+    0x75, 0x01,                    //     REPORT_SIZE (1)
+    0x81, 0x02,                    //     INPUT (Data,Var,Abs)
+    0x95, 0x01,                    //     REPORT_COUNT (1)
+    0x75, 0x06,                    //     REPORT_SIZE (6)
+    0x81, 0x03,                    //     INPUT (Const,Var,Abs)
+    0x05, 0x01,                    //     USAGE_PAGE (Generic Desktop)
+    0x09, 0x30,                    //     USAGE (X)
+    0x09, 0x31,                    //     USAGE (Y)
+    0x16, 0x01, 0x80,              //     LOGICAL_MINIMUM (-32767)
+    0x26, 0xff, 0x7f,              //     LOGICAL_MAXIMUM (32767)
+    0x75, 0x10,                    //     REPORT_SIZE (16)
+    0x95, 0x02,                    //     REPORT_COUNT (2)
+    0x81, 0x06,                    //     INPUT (Data,Var,Rel)
+	0x09, 0x00,                    //     USAGE (Undefined) // Used to trig bootloader when SET FEATURE
+    0x15, 0x00,                    //     LOGICAL_MINIMUM (0)
+    0x26, 0xff, 0x00,              //     LOGICAL_MAXIMUM (255)
+    0x75, 0x08,                    //     REPORT_SIZE (8)
+    0x95, 0x04,                    //     REPORT_COUNT (4) // GET FEATURE: skipped states X, Y (16 bits each)
+    0xb2, 0x02, 0x01,              //     FEATURE (Data,Var,Abs,Buf)
+    0xC0,                          //   END_COLLECTION
+    0xC0,                          // END COLLECTION
+};
+/* The data described by this descriptor consists of 5 bytes:
+ *      .  .  .  .  .  . B1 B0 .... one byte with mouse button states
+ *     X15 ... X0 ................. 16 bit signed relative coordinate x
+ *     Y15 ... Y0 ................. 16 bit signed relative coordinate y
+ */
+typedef struct{
+    uchar   buttonMask;
+    int     dx;
+    int     dy;
+}report_t;
+
+static report_t reportBuffer;
+static uchar    idleRate;   /* repeat rate for keyboards, never used for mice */
+static uchar    diagBuffer[4];
+
+/* ------------------------------------------------------------------------- */
+
+usbMsgLen_t usbFunctionSetup(uchar data[8])
+{
+usbRequest_t    *rq = (void *)data;
+
+    /* The following requests are never used. But since they are required by
+     * the specification, we implement them in this example.
+     */
+    if((rq->bmRequestType & USBRQ_TYPE_MASK) == USBRQ_TYPE_CLASS){    /* class request type */
+        if(rq->bRequest == USBRQ_HID_GET_REPORT){  /* wValue: ReportType (highbyte), ReportID (lowbyte) */
+			if(rq->wValue.bytes[1] == 3){	/* Feature report: quadrature diagnostics */
+				cli();
+				diagBuffer[0] = skip_x;
+				diagBuffer[1] = skip_x>>8;
+				diagBuffer[2] = skip_y;
+				diagBuffer[3] = skip_y>>8;
+				sei();
+				usbMsgPtr = (usbMsgPtr_t)diagBuffer;
+				return sizeof(diagBuffer);
+			}
+            /* only one input report, so don't look at the report ID */
+            usbMsgPtr = (usbMsgPtr_t)&reportBuffer;
+            return sizeof(reportBuffer);
+		}else if(rq->bRequest == USBRQ_HID_SET_REPORT){
+			return USB_NO_MSG;  /* use usbFunctionWrite() to receive data from host */
+        }else if(rq->bRequest == USBRQ_HID_GET_IDLE){
+            usbMsgPtr = (usbMsgPtr_t)&idleRate;
+            return 1;
+        }else if(rq->bRequest == USBRQ_HID_SET_IDLE){
+            idleRate = rq->wValue.bytes[1];
+        }
+    }
+
+    return 0;   /* default for not implemented requests: return no data back to host */
+}
+
+uchar   usbFunctionWrite(uchar *data, uchar len)
+{
+	if(data[0]==0x5A)
+		jumptobootloader=1;
+	return len;
+}
+
+/* ------------------------------------------------------------------------- */
+
+__attribute__ ((OS_main)) int main(void)
+{
+    wdt_enable(WDTO_2S);
+    /* Even if you don't use the watchdog, turn it off here. On newer devices,
+     * the status of the watchdog (on/off, period) is PRESERVED OVER RESET!
+     */
+    /* RESET status: all port bits are inputs without pull-up.
+     * That's the way we need D+ and D-. Therefore we don't need any
+     * additional hardware initialization.
+     */
+	jumptobootloader=0;
+	RollerInit();
+    usbInit();
+    usbDeviceDisconnect();  /* enforce re-enumeration, do this while interrupts are disabled! */
+	_delay_ms(10);	// 10ms is enough to see the USB disconnection and reconnection
+    usbDeviceConnect();
+    sei();
+    for(;;){                /* main event loop */
+        wdt_reset();
+		if(jumptobootloader)
+		{
+			cli(); // Clear interrupts
+			/* magic boot key in memory to invoke reflashing 0x013B-0x013C = BEEF */
+			unsigned int *BootKey=(unsigned int*)0x013b;
+			*BootKey=0xBEEF;
+
+			/* USB disconnect */
+			DDRD |= ((1<<PD0)|(1<<PD2));
+			for(;;); // Let wdt reset the CPU
+		}
+        usbPoll();
+
+		/* Read the buttons periodically */
+		if(TIFR2 & (1<<OCF2A))
+		{
+			TIFR2 = 1<<OCF2A;
+			RollerUpdate();
+		}
+
+        if(usbInterruptIsReady()){
+            /* called after every poll of the interrupt endpoint */
+			if(UpdateReportBuffer())
+				usbSetInterrupt((void *)&reportBuffer, sizeof(reportBuffer));
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Sub controllers are read one per tick, like in ColecoVision_Controller_v3.2:
+ * the select lines are switched after a read and the other sub controller is
+ * read ~1ms later, once the lines have settled.
+ */
+#define SELECT_1	0	// Fire button
+#define SELECT_2	1	// Arm button
+
+static void RollerSelect(unsigned char sub)
+{
+	if (sub == SELECT_1)
+	{
+		PORTC |= ((1<<PC1)|(1<<PC3)); // Sub controller 1 selected
+		PORTD &= ~((1<<PD7));
+	}
+	else
+	{
+		PORTC &= ~((1<<PC1)|(1<<PC3)); // Sub controller 2 selected
+		PORTD |= ((1<<PD7));
+	}
+
+	selected = sub;
+}
+
+static void RollerInit(void)
+{
+
+#define ROLLER_XA	PB5
+#define ROLLER_XB	PC2
+#define ROLLER_YA	PD4
+#define ROLLER_YB	PD3
+#define ROLLER_BUT	PB4
+
+	/* Port 1 (adapter DB9)
+	 * PIN1 = PB0   = nc
+	 * PIN2 = PB1   = nc
+	 * PIN3 = PB2   = nc
+	 * PIN4 = PB3   = nc
+	 * PIN5 = PC1&3 = select sub controller 2 (OUT)
+	 * PIN6 = PB4   = fire button / arm button (IN, w/Pull-up)
+	 * PIN7 = PB5   = X quadrature input A (IN, w/Pull-up)
+	 * PIN8 = PD7   = select sub controller 1 (OUT)
+	 * PIN9 = PC0&2 = X quadrature input B (IN, w/Pull-up)
+	 *
+	 * Port 2, spinner lines only
+	 * PIN7 = PD4   = Y quadrature input A (IN, w/Pull-up)
+	 * PIN9 = PD3   = Y quadrature input B (IN, w/Pull-up)
+	 */
+
+	DDRB &= ~((1<<PB4)|(1<<PB5));
+	PORTB |= ((1<<PB4)|(1<<PB5));
+
+	DDRC &= ~((1<<PC0)|(1<<PC2));
+	DDRC |= ((1<<PC1)|(1<<PC3));
+	PORTC |= (1<<PC2);
+	PORTC &= ~(1<<PC0);
+
+	DDRD &= ~((1<<PD3)|(1<<PD4));
+	PORTD |= ((1<<PD3)|(1<<PD4));
+	DDRD |= (1<<PD7);
+
+	RollerSelect(SELECT_1);
+
+	count_x = count_y = 0;
+	buttons = reported_buttons = 0;
+	old_quad = ((~PINB&(1<<ROLLER_XA))?1:0)|((~PINC&(1<<ROLLER_XB))?2:0)|((~PIND&(1<<ROLLER_YA))?4:0)|((~PIND&(1<<ROLLER_YB))?8:0);	// Initial read
+
+	PCMSK0 |= (1<<PCINT5);	// XA
+	PCMSK1 |= (1<<PCINT10);	// XB
+	PCMSK2 |= ((1<<PCINT20)|(1<<PCINT19));	// YA, YB
+	PCIFR = ((1<<PCIF0)|(1<<PCIF1)|(1<<PCIF2));
+	PCICR |= ((1<<PCIE0)|(1<<PCIE1)|(1<<PCIE2));
+
+	/* configure timer 2 for a rate of 12M/(1024 * 12) = 976 Hz (~1ms) */
+	TCCR2A = (1<<WGM21);
+	TCCR2B = (1<<CS22)|(1<<CS21)|(1<<CS20);
+	OCR2A = 11;
+}
+
+ISR(PCINT0_vect) // Trigged whenever a bit change on a quadrature input, of any port
+{
+	// Quad Format (4 bits): MSB YB YA XB XA LSB
+	unsigned char quad = ((~PINB&(1<<ROLLER_XA))?1:0)|((~PINC&(1<<ROLLER_XB))?2:0)|((~PIND&(1<<ROLLER_YA))?4:0)|((~PIND&(1<<ROLLER_YB))?8:0);
+
+	// Apply delta displacement from quadrature, in x and y.
+	// Table Format (4 bits): MSB OldB OldA ActualB ActualA LSB
+	count_x += QuadStep(QEM[(quad&3)|((old_quad&3)<<2)], &dir_x, &skip_x);
+	count_y += QuadStep(QEM[(quad>>2)|(old_quad&0x0C)], &dir_y, &skip_y);
+
+	old_quad = quad;	// Keep previous value of the inputs for quadrature calculation.
+}
+
+ISR(PCINT1_vect, ISR_ALIASOF(PCINT0_vect));
+ISR(PCINT2_vect, ISR_ALIASOF(PCINT0_vect));
+
+static void RollerUpdate(void)
+{
+	// Read the sub controller selected on the previous tick, select the other one
+	if (PINB&(1<<ROLLER_BUT))
+		buttons &= ~(1<<selected);
+	else
+		buttons |= (1<<selected);
+
+	RollerSelect(selected == SELECT_1 ? SELECT_2 : SELECT_1);
+}
+
+/* Take the steps of one axis, what does not fit in a report stays for the next one */
+static int RollerTake(volatile int *count)
+{
+	int d;
+
+	cli();
+	d = *count;
+	if (d > MAX_COUNT)
+		d = MAX_COUNT;
+	if (d < -MAX_COUNT)
+		d = -MAX_COUNT;
+	*count -= d;
+	sei();
+
+	return d*MULT;
+}
+
+static char UpdateReportBuffer(void)
+{
+	// Send up to date delta displacements that happened during the USB polling interval.
+	reportBuffer.dx = RollerTake(&count_x);
+	reportBuffer.dy = RollerTake(&count_y);
+
+	// Button Format (2 bits): MSB ARM FIRE LSB
+	reportBuffer.buttonMask = buttons;
+
+	// Nothing moved, no report
+	if (!reportBuffer.dx && !reportBuffer.dy && buttons == reported_buttons)
+		return 0;
+
+	reported_buttons = buttons;
+	return 1;
+}
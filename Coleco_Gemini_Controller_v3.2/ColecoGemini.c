@@ -26,23 +26,44 @@
 #include <string.h>
 #include "usbconfig.h"
 #include "ColecoGemini.h"
+#include "rcpot.h"
+#include "potfilter.h"
 
-#define SETUPDELAY	5
+#define SETUPDELAY	8	// Time to reset the capacitor back to GND (timer1 ticks, 5uS)
 #define DIVIDER 64 // 1M pot
-#define TIMEOUT	65000
+#define TIMEOUT	20000	// Past full scale (255*DIVIDER), no pot
 
 static char ColecoGeminiInit(void);
 static void ColecoGeminiUpdate(void);
 static char ColecoGeminiChanged(char id);
 static char ColecoGeminiBuildReport(unsigned char *reportBuffer, char id);
-static void ColecoGeminiReadPot(void);
 
-volatile unsigned int pot,old_pot;
-volatile char flag;
+volatile unsigned int pot,old_pot;	// Filtered position, 0-255
+static PotFilter filter;
+
+static const RcPot pots[1] = {
+	{ RCPOT_COMPARATOR, &DDRC, &PINC, 0, (1<<PC1), 1 },
+};
 
 static unsigned char last_update_state=0;
 static unsigned char last_reported_state=0;
 
+static void ColecoGeminiPot(unsigned char i, unsigned int ticks)
+{
+	// Not connected, keep the last value
+	if (ticks == RCPOT_TIMEDOUT)
+		return;
+
+	// Re-rangeing the pot values between 0-255
+	ticks/=DIVIDER;
+
+	// Clip maximum value to 255
+	if(ticks>255)
+		ticks=255;
+
+	pot=potFilter(&filter, ticks);
+}
+
 static char ColecoGeminiInit(void)
 {
 
@@ -68,26 +89,19 @@ static char ColecoGeminiInit(void)
 	PORTC &= ~((1<<PC1)|(1<<PC3)|(1<<PC0)|(1<<PC2));
 
 	old_pot=pot=0;
+	potFilterInit(&filter, 0, 1);
 
-	ADCSRB |= (1<<ACME);	// Comparator negative input on ADC MUX.
-	ADCSRA &= ~(1<<ADEN);	// ADC off, Comparator on.
-	ACSR |= ((1<<ACBG)|(1<<ACIE)|(1<<ACIC)|(1<<ACIS1)); // Comparator positive input on BANDGAP. Interrupt enable on caparator
-	ADMUX=1; // Channel 1 selected (PC1)
-
-	TCCR1B |= ((1<<WGM12)|(1<<CS11));	// Timer1: CTC,XTAL/8
+	rcPotInit(pots, 1, (1<<CS11), SETUPDELAY, TIMEOUT, ColecoGeminiPot);	// Timer1: free running, XTAL/8
 
 	return 0;
 }
 
 static void ColecoGeminiUpdate(void)
 {
-	unsigned int i=0;
-
 	last_update_state = ((PINB&((1<<PB0)|(1<<PB1)|(1<<PB2)|(1<<PB3)|(1<<PB4))));
-	ColecoGeminiReadPot();
 
-	while(i<TIMEOUT && flag)
-		i++;
+	// Collect the last measurement and start the next one
+	rcPotPoll();
 }
 
 static char ColecoGeminiChanged(char id)
@@ -106,15 +120,8 @@ static char ColecoGeminiBuildReport(unsigned char *reportBuffer, char id)
 	{
 		y = x = 0x80;
 
-		// Re-rangeing the pot values between 0-255
-		z=(pot/DIVIDER);
-
-		// Clip maximum value to 255
-		if(z>255)
-			z=255;
-		
 		// Inverting pot values (cw to ccw)
-		z=255-z;
+		z=255-pot;
 
 		tmp = last_update_state ^ 0xff;
 
@@ -131,6 +138,7 @@ static char ColecoGeminiBuildReport(unsigned char *reportBuffer, char id)
 
 	}
 	last_reported_state = last_update_state;
+	old_pot = pot;
 
 	return REPORT_SIZE;
 }
@@ -207,19 +215,3 @@ Gamepad *ColecoGeminiGetGamepad(void)
 
 	return &ColecoGeminiJoy;
 }
-
-ISR(ANALOG_COMP_vect)
-{
-	pot=ICR1;		// Store triggered timer value 
-	flag=0;			// Lower reading in process flag.
-}
-
-void ColecoGeminiReadPot(void)
-{
-	flag=1;	// Read in process flag
-	DDRC |= (1<<PC1);	// Force port to ground
-	_delay_us(SETUPDELAY);	// Wait for capacitor to be discharged
-	DDRC &= ~(1<<PC1);	// Put back port in read mode (floating);
-	TCNT1=0;// Clear counter value
-}
-
@@ -35,8 +35,15 @@ static void intellivisionUpdate(void);
 static char intellivisionChanged(char id);
 static char intellivisionBuildReport(unsigned char *reportBuffer, char id);
 
+/* Number of consecutive identical samples (1 per ~1ms tick) before a new code
+ * is accepted. Rolling the disc or half pressing a key gives transient codes
+ * (a keypad key, or even K1+K9 Pause) lasting a sample or two. */
+#define STABLE_SAMPLES	3
+
 static unsigned char last_update_state=0;
 static unsigned char last_reported_state=0;
+static unsigned char candidate_state=0;
+static unsigned char stable_count=0;
 
 static char intellivisionInit(void)
 {
@@ -92,18 +99,37 @@ static char intellivisionInit(void)
 
 static void intellivisionUpdate(void)
 {
-	//				Bit7	Bit6	Bit5	Bit4	Bit3	Bit2	Bit1	Bit0
-	// Mattel		PC2		PD7		PB5		PB4		PB3		PB2		PB1		PB0
-	// Flashback	PC3		PB4		PB5		PB1		PB0		PD7		PB3		PC2
-	// Looks complex but it's for placing bits in the corresponding order to match original gamepad for simple decoding.
-	last_update_state = (((PINB&(1<<PB0))?(1<<3):0)|
-						((PINB&(1<<PB1))?(1<<4):0)|
-						((PINB&(1<<PB3))?(1<<1):0)|
-						((PINB&(1<<PB4))?(1<<6):0)|
-						((PINB&(1<<PB5))?(1<<5):0)|
-						((PINC&(1<<PC2))?(1<<0):0)|
-						((PIND&(1<<PD7))?(1<<2):0)|
-						((PINC&(1<<PC3))?(1<<7):0));
+	// One snapshot of each port, back to back, so the bits below all come from the same instant
+	unsigned char pinb = PINB;
+	unsigned char pinc = PINC;
+	unsigned char pind = PIND;
+
+	/* Reorder readings to match original firmware decoding
+	 *	Bit7	Bit6	Bit5	Bit4	Bit3	Bit2	Bit1	Bit0
+	 *	PC3		PB4		PB5		PB1		PB0		PD7		PB3		PC2
+	 */
+	unsigned char state = (((pinb&(1<<PB0))?(1<<3):0)|
+						((pinb&(1<<PB1))?(1<<4):0)|
+						((pinb&(1<<PB3))?(1<<1):0)|
+						((pinb&(1<<PB4))?(1<<6):0)|
+						((pinb&(1<<PB5))?(1<<5):0)|
+						((pinc&(1<<PC2))?(1<<0):0)|
+						((pind&(1<<PD7))?(1<<2):0)|
+						((pinc&(1<<PC3))?(1<<7):0));
+
+	// Only report a code once it has been read STABLE_SAMPLES times in a row
+	if (state != candidate_state)
+	{
+		candidate_state = state;
+		stable_count = 1;
+	}
+	else if (stable_count < STABLE_SAMPLES)
+	{
+		stable_count++;
+	}
+
+	if (stable_count >= STABLE_SAMPLES)
+		last_update_state = candidate_state;
 }
 
 static char intellivisionChanged(char id)
@@ -111,73 +137,99 @@ static char intellivisionChanged(char id)
 	return (last_update_state != last_reported_state);
 }
 
+/* Decoding of the matrix code (inverted, 1 = contact), one entry per code:
+ * {X, Y, Btn 1-8, Btn 9-16}
+ *
+ * Disc (16 directions, code&0x8F), then action buttons (S1-S3, code&0x70)
+ * and finally keypad (K1-K9, Clear, K0, Enter and K1+K9 as Btn 16 (Pause),
+ * whole code). A keypad code centres the disc and replaces the action
+ * buttons. Every code costs the same single lookup.
+ *
+ *	Disc		N    NNE  NE   ENE  E    ESE  SE   SSE  S    SSW  SW   WSW  W    WNW  NW   NNW
+ *	code&0x8F	0x02 0x82 0x86 0x06 0x04 0x84 0x8C 0x0C 0x08 0x88 0x89 0x09 0x01 0x81 0x83 0x03
+ *
+ *	Action		S1   S2   S3
+ *	code&0x70	0x50 0x60 0x30		Btn 1-3
+ *
+ *	Keypad		K1   K2   K3   K4   K5   K6   K7   K8   K9   Clr  K0   Ent  K1+K9
+ *	code		0x18 0x28 0x48 0x14 0x24 0x44 0x12 0x22 0x42 0x11 0x21 0x41 0x5A	Btn 4-16
+ */
+static const unsigned char intellivisionDecode[256][4] PROGMEM = {
+	/* 0x00 */ {0x80,0x80,0x00,0x00}, {0x00,0x80,0x00,0x00}, {0x80,0x00,0x00,0x00}, {0x40,0x00,0x00,0x00},
+	/* 0x04 */ {0xFF,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0xFF,0x40,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x08 */ {0x80,0xFF,0x00,0x00}, {0x00,0xC0,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x0C */ {0xC0,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x10 */ {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x10}, {0x80,0x80,0x00,0x02}, {0x40,0x00,0x00,0x00},
+	/* 0x14 */ {0x80,0x80,0x40,0x00}, {0x80,0x80,0x00,0x00}, {0xFF,0x40,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x18 */ {0x80,0x80,0x08,0x00}, {0x00,0xC0,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x1C */ {0xC0,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x20 */ {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x20}, {0x80,0x80,0x00,0x04}, {0x40,0x00,0x00,0x00},
+	/* 0x24 */ {0x80,0x80,0x80,0x00}, {0x80,0x80,0x00,0x00}, {0xFF,0x40,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x28 */ {0x80,0x80,0x10,0x00}, {0x00,0xC0,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x2C */ {0xC0,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x30 */ {0x80,0x80,0x04,0x00}, {0x00,0x80,0x04,0x00}, {0x80,0x00,0x04,0x00}, {0x40,0x00,0x04,0x00},
+	/* 0x34 */ {0xFF,0x80,0x04,0x00}, {0x80,0x80,0x04,0x00}, {0xFF,0x40,0x04,0x00}, {0x80,0x80,0x04,0x00},
+	/* 0x38 */ {0x80,0xFF,0x04,0x00}, {0x00,0xC0,0x04,0x00}, {0x80,0x80,0x04,0x00}, {0x80,0x80,0x04,0x00},
+	/* 0x3C */ {0xC0,0xFF,0x04,0x00}, {0x80,0x80,0x04,0x00}, {0x80,0x80,0x04,0x00}, {0x80,0x80,0x04,0x00},
+	/* 0x40 */ {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x40}, {0x80,0x80,0x00,0x08}, {0x40,0x00,0x00,0x00},
+	/* 0x44 */ {0x80,0x80,0x00,0x01}, {0x80,0x80,0x00,0x00}, {0xFF,0x40,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x48 */ {0x80,0x80,0x20,0x00}, {0x00,0xC0,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x4C */ {0xC0,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x50 */ {0x80,0x80,0x01,0x00}, {0x00,0x80,0x01,0x00}, {0x80,0x00,0x01,0x00}, {0x40,0x00,0x01,0x00},
+	/* 0x54 */ {0xFF,0x80,0x01,0x00}, {0x80,0x80,0x01,0x00}, {0xFF,0x40,0x01,0x00}, {0x80,0x80,0x01,0x00},
+	/* 0x58 */ {0x80,0xFF,0x01,0x00}, {0x00,0xC0,0x01,0x00}, {0x80,0x80,0x00,0x80}, {0x80,0x80,0x01,0x00},
+	/* 0x5C */ {0xC0,0xFF,0x01,0x00}, {0x80,0x80,0x01,0x00}, {0x80,0x80,0x01,0x00}, {0x80,0x80,0x01,0x00},
+	/* 0x60 */ {0x80,0x80,0x02,0x00}, {0x00,0x80,0x02,0x00}, {0x80,0x00,0x02,0x00}, {0x40,0x00,0x02,0x00},
+	/* 0x64 */ {0xFF,0x80,0x02,0x00}, {0x80,0x80,0x02,0x00}, {0xFF,0x40,0x02,0x00}, {0x80,0x80,0x02,0x00},
+	/* 0x68 */ {0x80,0xFF,0x02,0x00}, {0x00,0xC0,0x02,0x00}, {0x80,0x80,0x02,0x00}, {0x80,0x80,0x02,0x00},
+	/* 0x6C */ {0xC0,0xFF,0x02,0x00}, {0x80,0x80,0x02,0x00}, {0x80,0x80,0x02,0x00}, {0x80,0x80,0x02,0x00},
+	/* 0x70 */ {0x80,0x80,0x00,0x00}, {0x00,0x80,0x00,0x00}, {0x80,0x00,0x00,0x00}, {0x40,0x00,0x00,0x00},
+	/* 0x74 */ {0xFF,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0xFF,0x40,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x78 */ {0x80,0xFF,0x00,0x00}, {0x00,0xC0,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x7C */ {0xC0,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x80 */ {0x80,0x80,0x00,0x00}, {0x00,0x40,0x00,0x00}, {0xC0,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00},
+	/* 0x84 */ {0xFF,0xC0,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0xFF,0x00,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x88 */ {0x40,0xFF,0x00,0x00}, {0x00,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x8C */ {0xFF,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x90 */ {0x80,0x80,0x00,0x00}, {0x00,0x40,0x00,0x00}, {0xC0,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00},
+	/* 0x94 */ {0xFF,0xC0,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0xFF,0x00,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x98 */ {0x40,0xFF,0x00,0x00}, {0x00,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0x9C */ {0xFF,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0xA0 */ {0x80,0x80,0x00,0x00}, {0x00,0x40,0x00,0x00}, {0xC0,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00},
+	/* 0xA4 */ {0xFF,0xC0,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0xFF,0x00,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0xA8 */ {0x40,0xFF,0x00,0x00}, {0x00,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0xAC */ {0xFF,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0xB0 */ {0x80,0x80,0x04,0x00}, {0x00,0x40,0x04,0x00}, {0xC0,0x00,0x04,0x00}, {0x00,0x00,0x04,0x00},
+	/* 0xB4 */ {0xFF,0xC0,0x04,0x00}, {0x80,0x80,0x04,0x00}, {0xFF,0x00,0x04,0x00}, {0x80,0x80,0x04,0x00},
+	/* 0xB8 */ {0x40,0xFF,0x04,0x00}, {0x00,0xFF,0x04,0x00}, {0x80,0x80,0x04,0x00}, {0x80,0x80,0x04,0x00},
+	/* 0xBC */ {0xFF,0xFF,0x04,0x00}, {0x80,0x80,0x04,0x00}, {0x80,0x80,0x04,0x00}, {0x80,0x80,0x04,0x00},
+	/* 0xC0 */ {0x80,0x80,0x00,0x00}, {0x00,0x40,0x00,0x00}, {0xC0,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00},
+	/* 0xC4 */ {0xFF,0xC0,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0xFF,0x00,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0xC8 */ {0x40,0xFF,0x00,0x00}, {0x00,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0xCC */ {0xFF,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0xD0 */ {0x80,0x80,0x01,0x00}, {0x00,0x40,0x01,0x00}, {0xC0,0x00,0x01,0x00}, {0x00,0x00,0x01,0x00},
+	/* 0xD4 */ {0xFF,0xC0,0x01,0x00}, {0x80,0x80,0x01,0x00}, {0xFF,0x00,0x01,0x00}, {0x80,0x80,0x01,0x00},
+	/* 0xD8 */ {0x40,0xFF,0x01,0x00}, {0x00,0xFF,0x01,0x00}, {0x80,0x80,0x01,0x00}, {0x80,0x80,0x01,0x00},
+	/* 0xDC */ {0xFF,0xFF,0x01,0x00}, {0x80,0x80,0x01,0x00}, {0x80,0x80,0x01,0x00}, {0x80,0x80,0x01,0x00},
+	/* 0xE0 */ {0x80,0x80,0x02,0x00}, {0x00,0x40,0x02,0x00}, {0xC0,0x00,0x02,0x00}, {0x00,0x00,0x02,0x00},
+	/* 0xE4 */ {0xFF,0xC0,0x02,0x00}, {0x80,0x80,0x02,0x00}, {0xFF,0x00,0x02,0x00}, {0x80,0x80,0x02,0x00},
+	/* 0xE8 */ {0x40,0xFF,0x02,0x00}, {0x00,0xFF,0x02,0x00}, {0x80,0x80,0x02,0x00}, {0x80,0x80,0x02,0x00},
+	/* 0xEC */ {0xFF,0xFF,0x02,0x00}, {0x80,0x80,0x02,0x00}, {0x80,0x80,0x02,0x00}, {0x80,0x80,0x02,0x00},
+	/* 0xF0 */ {0x80,0x80,0x00,0x00}, {0x00,0x40,0x00,0x00}, {0xC0,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00},
+	/* 0xF4 */ {0xFF,0xC0,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0xFF,0x00,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0xF8 */ {0x40,0xFF,0x00,0x00}, {0x00,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+	/* 0xFC */ {0xFF,0xFF,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00}, {0x80,0x80,0x00,0x00},
+};
+
 #define REPORT_SIZE 5
 
 static char intellivisionBuildReport(unsigned char *reportBuffer, char id)
 {
-	int x,y;
-	unsigned char tmp,but[2];
+	unsigned char tmp;
 	
 	if (reportBuffer)
 	{
 		tmp = (last_update_state ^ 0xff);
-		
-		//Scan direction disc first
-		switch(tmp&0x8F)
-		{
-			case 0b00000010: x = 0x80; y = 0x00; but[0]=but[1]=0; break; //D1 Disc N
-			case 0b10000010: x = 0xC0; y = 0x00; but[0]=but[1]=0; break; //D2 Disc NNE
-			case 0b10000110: x = 0xFF; y = 0x00; but[0]=but[1]=0; break; //D3 Disc NE 
-			case 0b00000110: x = 0xFF; y = 0x40; but[0]=but[1]=0; break; //D4 Disc ENE
-			case 0b00000100: x = 0xFF; y = 0x80; but[0]=but[1]=0; break; //D5 Disc E
-			case 0b10000100: x = 0xFF; y = 0xC0; but[0]=but[1]=0; break; //D6 Disc ESE
-			case 0b10001100: x = 0xFF; y = 0xFF; but[0]=but[1]=0; break; //D7 Disc SE
-			case 0b00001100: x = 0xC0; y = 0xFF; but[0]=but[1]=0; break; //D8 Disc SSE
-			case 0b00001000: x = 0x80; y = 0xFF; but[0]=but[1]=0; break; //D9 Disc S
-			case 0b10001000: x = 0x40; y = 0xFF; but[0]=but[1]=0; break; //D10 Disc SSW
-			case 0b10001001: x = 0x00; y = 0xFF; but[0]=but[1]=0; break; //D11 Disc SW
-			case 0b00001001: x = 0x00; y = 0xC0; but[0]=but[1]=0; break; //D12 Disc WSW
-			case 0b00000001: x = 0x00; y = 0x80; but[0]=but[1]=0; break; //D13 Disc W
-			case 0b10000001: x = 0x00; y = 0x40; but[0]=but[1]=0; break; //D14 Disc WNW
-			case 0b10000011: x = 0x00; y = 0x00; but[0]=but[1]=0; break; //D15 Disc NW
-			case 0b00000011: x = 0x40; y = 0x00; but[0]=but[1]=0; break; //D16 Disc NNW
-
-			default: y = x = 0x80; //D0 Disc centered
-		}
-
-		//Then scan action buttons (3 buttons)
-		switch(tmp&0x70)
-		{
-
-			case 0b01010000:  but[1]=0b00000000; but[0]=0b00000001; break; //S1 Button 1
-			case 0b01100000:  but[1]=0b00000000; but[0]=0b00000010; break; //S2 Button 2
-			case 0b00110000:  but[1]=0b00000000; but[0]=0b00000100; break; //S3 Button 3
-
-			default: but[2]=but[1]=but[0]=0; //All buttons depressed
-		}
-
-		//Finally, scan keypad (12 buttons)
-		switch(tmp)
-		{
-
-			case 0b00011000: x = y = 0x80;  but[1]=0b00000000; but[0]=0b00001000; break; //K1 Keypad 1
-			case 0b00101000: x = y = 0x80;  but[1]=0b00000000; but[0]=0b00010000; break; //K2 Keypad 2
-			case 0b01001000: x = y = 0x80;  but[1]=0b00000000; but[0]=0b00100000; break; //K3 Keypad 3
-			case 0b00010100: x = y = 0x80;  but[1]=0b00000000; but[0]=0b01000000; break; //K4 Keypad 4
-			case 0b00100100: x = y = 0x80;  but[1]=0b00000000; but[0]=0b10000000; break; //K5 Keypad 5
-			case 0b01000100: x = y = 0x80;  but[1]=0b00000001; but[0]=0b00000000; break; //K6 Keypad 6
-			case 0b00010010: x = y = 0x80;  but[1]=0b00000010; but[0]=0b00000000; break; //K7 Keypad 7
-			case 0b00100010: x = y = 0x80;  but[1]=0b00000100; but[0]=0b00000000; break; //K8 Keypad 8
-			case 0b01000010: x = y = 0x80;  but[1]=0b00001000; but[0]=0b00000000; break; //K9 Keypad 9
-			case 0b00010001: x = y = 0x80;  but[1]=0b00010000; but[0]=0b00000000; break; //Clear Keypad Clear
-			case 0b00100001: x = y = 0x80;  but[1]=0b00100000; but[0]=0b00000000; break; //K0 Keypad 0
-			case 0b01000001: x = y = 0x80;  but[1]=0b01000000; but[0]=0b00000000; break; //Enter Keypad Enter
-
-			//Special case, keypad combinations
-			case 0b01011010: x = y = 0x80;  but[1]=0b10000000; but[0]=0b00000000; break; //[K1+K9] to Btn 16 (Pause)
-
-			default: but[1]=0; but[0] &= 0x07; //Keypad depressed	
-		}
 
 	   /*
  		* [0] X
@@ -187,10 +239,7 @@ static char intellivisionBuildReport(unsigned char *reportBuffer, char id)
 		* [4] Raw controller input with no interpretation (8 bits)
  		*/
 
-		reportBuffer[0] = x;
-		reportBuffer[1] = y;
-		reportBuffer[2] = but[0];
-		reportBuffer[3] = but[1];
+		memcpy_P(reportBuffer, intellivisionDecode[tmp], 4);
 		reportBuffer[4] = tmp;
 
 	}
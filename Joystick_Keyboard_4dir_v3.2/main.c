@@ -25,6 +25,7 @@
 #include <avr/interrupt.h>  /* for sei() */
 #include <util/delay.h>     /* for _delay_ms() */
 #include <avr/pgmspace.h>   /* required by usbdrv.h */
+#include <avr/eeprom.h>
 #include "usbdrv.h"
 
 #include "../bootloader/fuses.h"
@@ -44,9 +45,6 @@ const char usbHidReportDescriptor[] PROGMEM = {
     0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
     0x25, 0x01,                    //   LOGICAL_MAXIMUM (1)
     0x81, 0x02,                    //   INPUT (Data,Var,Abs) ; Modifier byte
-    0x95, 0x01,                    //   REPORT_COUNT (1)
-    0x75, 0x08,                    //   REPORT_SIZE (8)
-    0x81, 0x03,                    //   INPUT (Cnst,Var,Abs) ; Reserved byte
     0x95, 0x05,                    //   REPORT_COUNT (5)
     0x75, 0x01,                    //   REPORT_SIZE (1)
     0x05, 0x08,                    //   USAGE_PAGE (LEDs)
@@ -56,32 +54,315 @@ const char usbHidReportDescriptor[] PROGMEM = {
     0x95, 0x01,                    //   REPORT_COUNT (1)
     0x75, 0x03,                    //   REPORT_SIZE (3)
     0x91, 0x03,                    //   OUTPUT (Cnst,Var,Abs) ; LED report padding
-    0x95, 0x06,                    //   REPORT_COUNT (6)
-    0x75, 0x08,                    //   REPORT_SIZE (8)
+    0x95, 0x68,                    //   REPORT_COUNT (104)
+    0x75, 0x01,                    //   REPORT_SIZE (1)
     0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
-    0x25, 0x65,                    //   LOGICAL_MAXIMUM (101)
+    0x25, 0x01,                    //   LOGICAL_MAXIMUM (1)
     0x05, 0x07,                    //   USAGE_PAGE (Keyboard)(Key Codes)
     0x19, 0x00,                    //   USAGE_MINIMUM (Reserved (no event indicated))(0)
-    0x29, 0x65,                    //   USAGE_MAXIMUM (Keyboard Application)(101)
-    0x81, 0x00,                    //   INPUT (Data,Ary,Abs)
+    0x29, 0x67,                    //   USAGE_MAXIMUM (Keypad =)(103)
+    0x81, 0x02,                    //   INPUT (Data,Var,Abs) ; Key bitmap (NKRO)
 	0x09, 0x00,                    //   USAGE (Undefined) // Used to trig bootloader when SET FEATURE
 	0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
 	0x26, 0xff, 0x00,              //   LOGICAL_MAXIMUM (255)
 	0x75, 0x08,                    //   REPORT_SIZE (8)
-	0x95, 0x01,                    //   REPORT_COUNT (1)
+	0x95, 0x10,                    //   REPORT_COUNT (16) // Keymap programming, see KEYMAP_REPORT_SIZE
 	0xb2, 0x02, 0x01,              //   FEATURE (Data,Var,Abs,Buf)
     0xc0                           // END_COLLECTION
 };
 
+#define KEY_KP1 0x59 // Keypad 1 and End
+#define KEY_KP2 0x5a // Keypad 2 and Down Arrow
+#define KEY_KP3 0x5b // Keypad 3 and PageDn
+#define KEY_KP4 0x5c // Keypad 4 and Left Arrow
+#define KEY_KP5 0x5d // Keypad 5
+#define KEY_KP6 0x5e // Keypad 6 and Right Arrow
+#define KEY_KP7 0x5f // Keypad 7 and Home
+#define KEY_KP8 0x60 // Keypad 8 and Up Arrow
+#define KEY_KP9 0x61 // Keypad 9 and Page Up
+#define KEY_KP0 0x62 // Keypad 0 and Insert
+
+/*
+JoyBuf
+R	L	D	U
+3	2	1	0
+0	0	0	0	=	0x00 = 0x00 (Center or nothing pressed)
+0	0	0	1	=	0x01 = 0x60 (Up, KP8)
+0	0	1	0	=	0x02 = 0x5A (Down, KP2)
+0	0	1	1	=	0x03 = 0xFF (Impossible)
+0	1	0	0	=	0x04 = 0x5C (Left, KP4)
+0	1	0	1	=	0x05 = 0x5F (Up-Left, KP7, Home)
+0	1	1	0	=	0x06 = 0x59 (Down-Left, KP1, End)
+0	1	1	1	=	0x07 = 0xFF (impossible)
+1	0	0	0	=	0x08 = 0x5E (Right, KP6)
+1	0	0	1	=	0x09 = 0x61 (Up-Right, KP9, PgUp)
+1	0	1	0	=	0x0A = 0x5B (Down-Right, KP3, PgDown)
+x	x	x	x	= 0xFF (Impossible)
+
+4 = button	0	1	= 0x0B = 0x5D (KP5)		
+*/
+
+#define KEYMAP_SIZE	12
+
+// Keymap is located at 0x6E00 in flash memory, it is the factory default of every profile
+uchar key_map_flash[KEYMAP_SIZE]  __attribute__((used, section(".keymap"))) = {0,KEY_KP8,KEY_KP2,0xff,KEY_KP4,0xff,0xff,0xff,KEY_KP6,0xff,0xff,KEY_KP5};
+
+/* Keymaps can be changed at runtime with the 16 bytes feature report:
+ *
+ * [0] Command		[1]			[2..13]
+ * 'K' (0x4B)		Profile		Keymap, same layout as key_map_flash	Write a profile
+ * 'P' (0x50)		Profile		-										Select the active profile
+ * 'C' (0x43)		0/1			-										Disable/enable profile switching by combo
+ * 'R' (0x52)		-			-										Reset every profile to the flash keymap
+ * 0x5A				-			-										Jump to bootloader (also as a 1 byte report)
+ *
+ * Reading the feature report gives [0] active profile, [1] KEYMAP_PROFILES,
+ * [2] combo enabled, [3] KEYMAP_SIZE and [4..15] the active keymap.
+ *
+ * Settings are kept in EEPROM (the application can't rewrite its own flash,
+ * SPM only runs from the bootloader section). When enabled, holding the
+ * button and UP for COMBO_TICKS switches to the next profile.
+ */
+#define KEYMAP_REPORT_SIZE	16
+#define KEYMAP_PROFILES		4
+#define KEYMAP_MAGIC		0x4B
+
+#define CMD_WRITE_KEYMAP	'K'
+#define CMD_SELECT_PROFILE	'P'
+#define CMD_COMBO			'C'
+#define CMD_RESET			'R'
+#define CMD_BOOTLOADER		0x5A
+
+#define COMBO_JOYBUF		0x11	// Button + UP
+#define COMBO_TICKS			2000	// 2 seconds at ~1 kHz
+
+typedef struct {
+	uchar magic;
+	uchar profile;
+	uchar combo;
+	uchar map[KEYMAP_PROFILES][KEYMAP_SIZE];
+} KeymapSettings;
+
+static KeymapSettings EEMEM ee_settings;
+static KeymapSettings settings;
+static uchar *key_map;				// Active profile in settings.map
+static uchar save_index;			// Next step of the EEPROM save, KEYMAP_SAVE_IDLE when idle
+
+#define KEYMAP_SAVE_IDLE	(sizeof(KeymapSettings)+1)
+
+static uchar feature_buffer[KEYMAP_REPORT_SIZE];
+static uchar write_offset, write_length;
+
+static void keymapSelect(uchar profile)
+{
+	if (profile >= KEYMAP_PROFILES)
+		return;
+
+	settings.profile = profile;
+	key_map = settings.map[profile];
+}
+
+static void keymapReset(void)
+{
+	uchar i,j;
+
+	settings.magic = KEYMAP_MAGIC;
+	settings.profile = 0;
+	settings.combo = 0;
+	for(i=0;i<KEYMAP_PROFILES;i++) // Copy keymap in flash into every profile
+		for(j=0;j<KEYMAP_SIZE;j++)
+			settings.map[i][j] = pgm_read_byte(key_map_flash+j);
+}
+
+static void keymapLoad(void)
+{
+	eeprom_read_block(&settings, &ee_settings, sizeof(settings));
+
+	if (settings.magic != KEYMAP_MAGIC || settings.profile >= KEYMAP_PROFILES)
+	{
+		keymapReset();
+		save_index = 0;
+	}
+	keymapSelect(settings.profile);
+}
+
+/* Write the settings one byte per call, so the main loop never waits on the EEPROM.
+ * The magic is cleared first and written last: a save cut short by unplugging
+ * reloads the flash keymap rather than a half written one.
+ */
+static void keymapSave(void)
+{
+	if (save_index >= KEYMAP_SAVE_IDLE || !eeprom_is_ready())
+		return;
+
+	if (save_index == 0)
+		eeprom_update_byte(&ee_settings.magic, (uchar)~KEYMAP_MAGIC);
+	else if (save_index < sizeof(settings))
+		eeprom_update_byte((uchar *)&ee_settings + save_index, ((uchar *)&settings)[save_index]);
+	else
+		eeprom_update_byte(&ee_settings.magic, KEYMAP_MAGIC);
+	save_index++;
+}
+
+static void keymapCommand(uchar *data)
+{
+	uchar i;
+
+	switch(data[0])
+	{
+		case CMD_WRITE_KEYMAP:
+			if (data[1] >= KEYMAP_PROFILES)
+				return;
+			for(i=0;i<KEYMAP_SIZE;i++)
+				settings.map[data[1]][i] = data[2+i];
+			break;
+
+		case CMD_SELECT_PROFILE:
+			keymapSelect(data[1]);
+			break;
+
+		case CMD_COMBO:
+			settings.combo = (data[1] != 0);
+			break;
+
+		case CMD_RESET:
+			keymapReset();
+			keymapSelect(0);
+			break;
+
+		case CMD_BOOTLOADER:
+			jumptobootloader=1;
+			return;
+
+		default:
+			return;
+	}
+	save_index = 0;
+}
+
+static uchar keymapStatus(void)
+{
+	uchar i;
+
+	feature_buffer[0] = settings.profile;
+	feature_buffer[1] = KEYMAP_PROFILES;
+	feature_buffer[2] = settings.combo;
+	feature_buffer[3] = KEYMAP_SIZE;
+	for(i=0;i<KEYMAP_SIZE;i++)
+		feature_buffer[4+i] = key_map[i];
+
+	return KEYMAP_REPORT_SIZE;
+}
+
+/* The report descriptor above is a N-key rollover bitmap, one bit per key
+ * code up to NKRO_KEYS, so every direction and the button can be held
+ * together. A BIOS (or anything asking for the boot protocol) gets the
+ * standard 6 keys boot report instead. Both are rebuilt from the whole
+ * joystick state by keyboardBuildReport().
+ */
+#define NKRO_KEYS	0x68
+
 typedef struct {
 	uint8_t modifier;
 	uint8_t reserved;
 	uint8_t keycode[6];
 } keyboard_report_t;
 
-static keyboard_report_t keyboard_report; // sent to PC
+typedef struct {
+	uint8_t modifier;
+	uint8_t bitmap[NKRO_KEYS/8];
+} nkro_report_t;
+
+static keyboard_report_t keyboard_report; // sent to PC in boot protocol
+static nkro_report_t nkro_report; // sent to PC in report protocol
 volatile static uchar LED_state = 0xff; // received from PC
 static uchar idleRate; // repeat rate for keyboards
+static uchar protocol = 1; // 0 = boot, 1 = report (default after reset)
+
+static uchar *report_ptr; // Part of the report still to send, reports over 8 bytes take 2 interrupt transfers
+static uchar report_left;
+static uchar dir_key; // Direction key sent, held by diagonals mapped to 0xff
+
+/* Called by the driver at the end of a bus reset. The host may not send
+ * SET_PROTOCOL, and HID 7.2.6 says the device starts in report protocol.
+ */
+void keyboardReset(void)
+{
+	protocol = 1;
+	report_left = 0;
+}
+
+static void keyboardAddKey(uchar code)
+{
+	uchar i;
+
+	if (code == 0 || code == 0xff)
+		return;
+
+	if (code >= 0xe0 && code <= 0xe7)
+	{
+		keyboard_report.modifier |= 1<<(code-0xe0);
+		nkro_report.modifier |= 1<<(code-0xe0);
+		return;
+	}
+
+	if (code < NKRO_KEYS)
+		nkro_report.bitmap[code>>3] |= 1<<(code&7);
+
+	for(i=0;i<sizeof(keyboard_report.keycode);i++)
+	{
+		if (keyboard_report.keycode[i] == code)
+			return;
+		if (keyboard_report.keycode[i] == 0)
+		{
+			keyboard_report.keycode[i] = code;
+			return;
+		}
+	}
+}
+
+/* Diagonals mapped to their own key (KP7/Home...) send that key, diagonals
+ * mapped to 0 send both direction keys, and diagonals mapped to 0xff (or
+ * impossible states) hold the previous direction key, as a 4 way stick. */
+static void keyboardBuildReport(uchar joybuf)
+{
+	uchar i,dir = joybuf&0x0f;
+	uchar both = 0;
+
+	for(i=0; i<sizeof(keyboard_report); i++)
+		((uchar *)&keyboard_report)[i] = 0;
+	for(i=0; i<sizeof(nkro_report); i++)
+		((uchar *)&nkro_report)[i] = 0;
+
+	if (dir < 0x0b && key_map[dir] != 0xff)
+	{
+		dir_key = key_map[dir];
+		both = (dir_key == 0); // Centered sends nothing either way
+	}
+
+	if (both)
+	{
+		for(i=0;i<4;i++)
+			if (dir & (1<<i))
+				keyboardAddKey(key_map[1<<i]);
+	}
+	else if (dir_key)
+		keyboardAddKey(dir_key);
+
+	if (joybuf&0x10)
+		keyboardAddKey(key_map[0x0b]);
+}
+
+static uchar keyboardReport(uchar **report)
+{
+	if (protocol)
+	{
+		*report = (uchar *)&nkro_report;
+		return sizeof(nkro_report);
+	}
+	*report = (uchar *)&keyboard_report;
+	return sizeof(keyboard_report);
+}
 
 usbMsgLen_t usbFunctionSetup(uchar data[8]) {
     usbRequest_t *rq = (void *)data;
@@ -90,18 +371,35 @@ usbMsgLen_t usbFunctionSetup(uchar data[8]) {
         switch(rq->bRequest) {
         case USBRQ_HID_GET_REPORT: // send "no keys pressed" if asked here
             // wValue: ReportType (highbyte), ReportID (lowbyte)
-            usbMsgPtr = (usbMsgPtr_t)&keyboard_report; // we only have this one
-            keyboard_report.modifier = 0;
-            keyboard_report.keycode[0] = 0;
-            return sizeof(keyboard_report);
-		case USBRQ_HID_SET_REPORT: // if wLength == 1, should be LED state
-            return (rq->wLength.word == 1) ? USB_NO_MSG : 0;
+            if(rq->wValue.bytes[1] == 3) { // Feature report, keymap status
+                usbMsgPtr = (usbMsgPtr_t)feature_buffer;
+                return keymapStatus();
+            }
+            {
+                uchar *report;
+                uchar len = keyboardReport(&report);
+                usbMsgPtr = (usbMsgPtr_t)report;
+                return len;
+            }
+		case USBRQ_HID_SET_REPORT: // if wLength == 1, should be LED state (or bootloader), else keymap command
+            if(rq->wLength.word == 0)
+                return 0;
+            write_offset = 0;
+            write_length = (rq->wLength.word > KEYMAP_REPORT_SIZE) ? KEYMAP_REPORT_SIZE : rq->wLength.word;
+            return USB_NO_MSG;
         case USBRQ_HID_GET_IDLE: // send idle rate to PC as required by spec
             usbMsgPtr = (usbMsgPtr_t)&idleRate;
             return 1;
         case USBRQ_HID_SET_IDLE: // save idle rate as required by spec
             idleRate = rq->wValue.bytes[1];
             return 0;
+        case USBRQ_HID_GET_PROTOCOL: // boot or report protocol
+            usbMsgPtr = (usbMsgPtr_t)&protocol;
+            return 1;
+        case USBRQ_HID_SET_PROTOCOL:
+            protocol = rq->wValue.bytes[0] ? 1 : 0;
+            report_left = 0;
+            return 0;
         }
     }
     
@@ -109,54 +407,52 @@ usbMsgLen_t usbFunctionSetup(uchar data[8]) {
 }
 
 usbMsgLen_t usbFunctionWrite(uint8_t * data, uchar len) {
-	if (data[0] == LED_state)
+	while(len-- && write_offset < write_length)
+		feature_buffer[write_offset++] = *data++;
+
+	if (write_offset < write_length)
+		return 0; // Expecting more
+
+	if (write_length != 1)
+	{
+		if (write_length == KEYMAP_REPORT_SIZE)
+			keymapCommand(feature_buffer);
+	}
+	else if (feature_buffer[0] == LED_state)
         return 1;
-    else if(data[0]==0x5A)
+    else if(feature_buffer[0]==0x5A)
 		jumptobootloader=1;
 	else
-        LED_state = data[0];
+        LED_state = feature_buffer[0];
 	
 	return 1; // Data read, not expecting more
 }
 
-//#define KEY_KP1 0x59 // Keypad 1 and End
-#define KEY_KP2 0x5a // Keypad 2 and Down Arrow
-//#define KEY_KP3 0x5b // Keypad 3 and PageDn
-#define KEY_KP4 0x5c // Keypad 4 and Left Arrow
-#define KEY_KP5 0x5d // Keypad 5
-#define KEY_KP6 0x5e // Keypad 6 and Right Arrow
-//#define KEY_KP7 0x5f // Keypad 7 and Home
-#define KEY_KP8 0x60 // Keypad 8 and Up Arrow
-//#define KEY_KP9 0x61 // Keypad 9 and Page Up
-//#define KEY_KP0 0x62 // Keypad 0 and Insert
+/* Debouncer, run on the ~1ms tick for the 5 inputs in parallel: one bit
+ * per input in each byte, the two bytes form a 2 bits counter per input
+ * (vertical counter). A press is taken at once, a release only once the
+ * input has read released on 4 consecutive ticks, so a chattering switch
+ * never drops and repeats a key.
+ */
+static uchar debounced; // Debounced joystick state, same layout as joybuf
+static uchar vc0=0xff, vc1=0xff;
 
-/*
-JoyBuf
-R	L	D	U
-3	2	1	0
-0	0	0	0	=	0x00 = 0x00 (Center or nothing pressed)
-0	0	0	1	=	0x01 = 0x60 (Up, KP8)
-0	0	1	0	=	0x02 = 0x5A (Down, KP2)
-0	0	1	1	=	0x03 = 0xFF (Impossible)
-0	1	0	0	=	0x04 = 0x5C (Left, KP4)
-0	1	0	1	=	0x05 = 0x5F (Up-Left, KP7, Home)
-0	1	1	0	=	0x06 = 0x59 (Down-Left, KP1, End)
-0	1	1	1	=	0x07 = 0xFF (impossible)
-1	0	0	0	=	0x08 = 0x5E (Right, KP6)
-1	0	0	1	=	0x09 = 0x61 (Up-Right, KP9, PgUp)
-1	0	1	0	=	0x0A = 0x5B (Down-Right, KP3, PgDown)
-x	x	x	x	= 0xFF (Impossible)
+static void keyboardDebounce(uchar raw)
+{
+	uchar release;
 
-4 = button	0	1	= 0x0B = 0x5D (KP5)		
-*/
+	debounced |= raw; // Presses are immediate
 
-// Keymap is located at 0x6E00 in flash memory
-uchar key_map_flash[]  __attribute__((used, section(".keymap"))) = {0,KEY_KP8,KEY_KP2,0xff,KEY_KP4,KEY_KP7,KEY_KP1,0xff,KEY_KP6,KEY_KP9,KEY_KP3,KEY_KP5};
+	release = debounced & ~raw;
+	vc0 = ~(vc0 & release);
+	vc1 = vc0 ^ (vc1 & release); // Counters of inputs not releasing stay reset to 3
+	debounced &= ~(release & vc0 & vc1); // Released after 4 ticks in a row
+}
 
 int main() {
 	uchar i;
 	uchar joybuf,reported_joybuf;
-	uchar key_map[sizeof(key_map_flash)];
+	unsigned int combo_ticks=0;
 
 	/* PB0   = PIN1 = UP 	(I,1)
 	 * PB1   = PIN2 = DOWN	(I,1)
@@ -179,13 +475,10 @@ int main() {
 	jumptobootloader=0;
 	
 	reported_joybuf=0;
-	joybuf=((~PINB)&0x1F);
+	joybuf=debounced=((~PINB)&0x1F);
 	
-    for(i=0; i<sizeof(keyboard_report); i++) // clear report initially
-        ((uchar *)&keyboard_report)[i] = 0;
-		
-	for(i=0;i<sizeof(key_map_flash);i++) // Copy keymap in flash into ram
-		((uchar *)&key_map)[i] = pgm_read_byte(key_map_flash+i);
+	save_index=KEYMAP_SAVE_IDLE;
+	keymapLoad(); // Keymap profiles from EEPROM, or from flash if EEPROM is blank
     
     wdt_enable(WDTO_1S); // enable 1s watchdog timer
 
@@ -199,6 +492,11 @@ int main() {
     usbDeviceConnect();
 	
     TCCR0B |= (1 << CS01); // timer 0 at clk/8 will generate randomness
+
+	/* configure timer 2 for a rate of 12M/(1024 * (11+1)) = 976.56 Hz (~1ms) */
+	TCCR2A = (1<<WGM21);
+	TCCR2B = (1<<CS22)|(1<<CS21)|(1<<CS20);
+	OCR2A = 11; // for ~1 khz, debouncer, EEPROM saves and profile combo
     
     sei(); // Enable interrupts after re-enumeration
 	
@@ -216,28 +514,48 @@ int main() {
 			for(;;); // Let wdt reset the CPU
 		}		
         usbPoll();
-        	
-		joybuf=((~PINB)&0x1F);
-		
-		if(usbInterruptIsReady() && joybuf!=reported_joybuf)
+
+		if (report_left && usbInterruptIsReady()) // Rest of a report over 8 bytes
 		{
-			//Joystick part
-			if((joybuf&0x0f)!=(reported_joybuf&0x0f))
-			{
-				if((key_map[(joybuf&0x0f)]!=0xff)&&((joybuf&0x0f)<0x0b))
-					keyboard_report.keycode[0]=key_map[joybuf&0x0f];
-			}
-			//Button part
-			if((joybuf&0x10)!=(reported_joybuf&0x10))
+			uchar len = (report_left > 8) ? 8 : report_left;
+			usbSetInterrupt(report_ptr, len);
+			report_ptr += len;
+			report_left -= len;
+		}
+
+		if (TIFR2 & (1<<OCF2A))
+		{
+			TIFR2 = 1<<OCF2A;
+
+			keyboardDebounce((~PINB)&0x1F);
+			joybuf=debounced;
+
+			keymapSave();
+
+			// Holding the combo switches to the next profile, once per hold
+			if (settings.combo && joybuf==COMBO_JOYBUF)
 			{
-				if(joybuf&0x10)
-					keyboard_report.keycode[1]=key_map[0x0b];
-				else
-					keyboard_report.keycode[1]=0;
+				if (combo_ticks < COMBO_TICKS && ++combo_ticks == COMBO_TICKS)
+				{
+					keymapSelect((settings.profile+1) % KEYMAP_PROFILES);
+					save_index = 0;
+				}
 			}
-			
-			keyboard_report.modifier = 0;
-			usbSetInterrupt((void *)&keyboard_report, sizeof(keyboard_report));
+			else
+				combo_ticks = 0;
+		}
+		
+		if(usbInterruptIsReady() && !report_left && joybuf!=reported_joybuf)
+		{
+			uchar len;
+
+			keyboardBuildReport(joybuf);
+			report_left = keyboardReport(&report_ptr);
+
+			len = (report_left > 8) ? 8 : report_left;
+			usbSetInterrupt(report_ptr, len);
+			report_ptr += len;
+			report_left -= len;
 
 			reported_joybuf=joybuf;
 		}
@@ -0,0 +1,127 @@
+/* "Mac" mouse pin map
+ * Copyright (C) 2021 Francis-Olivier Gradel, B.Eng.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The author may be contacted at info@retronicdesign.com
+ */
+
+#ifndef _mousemap_h__
+#define _mousemap_h__
+
+/* PB0   = PIN1 = GND (O,0)
+ * PB1   = PIN2 = VCC (O,1)
+ * PB2   = PIN3 = GND (O,0)
+ * PB3   = PIN4 = H   (I,1)
+ * PC1&3 = PIN5 = HQ  (I,1)
+ * PB4   = PIN6 = nc  (I,0)
+ * PB5   = PIN7 = BUT (I,1)
+ * PD7   = PIN8 = VQ  (I,1)
+ * PC0&2 = PIN9 = V   (I,1)
+ */
+
+#define MOUSE_PINS_B	((1<<PB0)|(1<<PB1)|(1<<PB2)|(1<<PB3)|(1<<PB4)|(1<<PB5))
+#define MOUSE_DDR_B		((1<<PB0)|(1<<PB1)|(1<<PB2))
+#define MOUSE_PORT_B	((1<<PB1)|(1<<PB3)|(1<<PB5))
+#define MOUSE_PINS_C	((1<<PC0)|(1<<PC1)|(1<<PC2)|(1<<PC3))
+#define MOUSE_PORT_C	((1<<PC0)|(1<<PC1)|(1<<PC2)|(1<<PC3))
+#define MOUSE_PINS_D	(1<<PD7)
+#define MOUSE_PORT_D	(1<<PD7)
+
+// The step lines are on three ports, the three vectors share one ISR
+#define MOUSE_PCMSK0	(1<<PCINT3)		// H
+#define MOUSE_PCMSK1	((1<<PCINT10)|(1<<PCINT11))	// V, HQ
+#define MOUSE_PCMSK2	(1<<PCINT23)	// VQ
+#define MOUSE_STEP_VECT	PCINT0_vect
+#define MOUSE_STEP_ALIAS1	PCINT1_vect
+#define MOUSE_STEP_ALIAS2	PCINT2_vect
+#define MOUSE_STEP_BITS	4
+#define MOUSE_STEP_READ()	(((PINC>>2)&0x03)|((PINB>>1)&0x04)|((PIND>>4)&0x08))	// Quad Format (4 bits): MSB VQ H HQ V LSB
+
+// Button Format (1 bit): BUT on PB5
+#define MOUSE_BUTTONS()	((~PINB>>5)&0x01)
+
+/* QEM explanation:
+ *
+ * Quadrature from an Mac mouse is made of two 90 degree out of phase signals that corresponds to
+ * two perforated wheels driven by the mouse ball. The perforated weels are hiding or showing IR LED
+ * to IR detectors on the other side that generate these signals. There are two pairs of these 
+ * signals, two for the horizontal and two for the vertical.
+ *
+ * Here is an example of a signal of a mouse going up:
+ *          ________            ________            ________            ____
+ *         /        \          /        \          /        \          /
+ * V  ____/          \________/          \________/          \________/
+ *              ________            ________            ________
+ *             /        \          /        \          /        \
+ * VQ ________/          \________/          \________/          \__________
+ *
+ * Here is an example of a signal of a mouse going down:
+ *
+ *          ________            ________            ________            ____
+ *         /        \          /        \          /        \          /
+ * V  ____/          \________/          \________/          \________/
+ * 
+ * VQ ________            ________            ________            ________
+ *            \          /        \          /        \          /
+ *             \________/          \________/          \________/
+ *
+ * Note on these two example the diffence in phase between V and VQ for up and down.
+ *
+ * Using these generated waves, we can determine by software the delta displacement of the mouse.
+ * The following table is generated by combining these signals in two 2-bit value, V, VQ, V' and VQ'.
+ *
+ *        Actual readed value (V-VQ 2-bit combinasion)
+ *        0   1   2   3
+ *     ----------------
+ *   0 |  0   1  -1   X
+ *   
+ *   1 | -1   0   X   1
+ *
+ *   2 |  1   X   0  -1
+ *  
+ *   3 |  X  -1   1   0
+ *
+ *   Previous readed value (V-VQ 2-bit combinasion)
+ *
+ * Note that this can be done for H-HQ in the exact same way.
+ */
+
+/* QUAD: the QEM above applied to both axes at once, indexed by the old and
+ * new quadrature nibbles: MSB old nibble, new nibble LSB.
+ * Nibble format: MSB VQ H HQ V LSB (PD7 PB3 PC3 PC2)
+ * Each entry is dx in the low byte and dy in the high byte, read with a
+ * single pgm_read_word() in the ISR.
+ */
+static const unsigned int QUAD[256] PROGMEM = {
+	/* 0 */ QD( 0, 0),QD( 0, 1),QD(-1, 0),QD(-1, 1),QD( 1, 0),QD( 1, 1),QD( 2, 0),QD( 2, 1),QD( 0,-1),QD( 0, 2),QD(-1,-1),QD(-1, 2),QD( 1,-1),QD( 1, 2),QD( 2,-1),QD( 2, 2),
+	/* 1 */ QD( 0,-1),QD( 0, 0),QD(-1,-1),QD(-1, 0),QD( 1,-1),QD( 1, 0),QD( 2,-1),QD( 2, 0),QD( 0, 2),QD( 0, 1),QD(-1, 2),QD(-1, 1),QD( 1, 2),QD( 1, 1),QD( 2, 2),QD( 2, 1),
+	/* 2 */ QD( 1, 0),QD( 1, 1),QD( 0, 0),QD( 0, 1),QD( 2, 0),QD( 2, 1),QD(-1, 0),QD(-1, 1),QD( 1,-1),QD( 1, 2),QD( 0,-1),QD( 0, 2),QD( 2,-1),QD( 2, 2),QD(-1,-1),QD(-1, 2),
+	/* 3 */ QD( 1,-1),QD( 1, 0),QD( 0,-1),QD( 0, 0),QD( 2,-1),QD( 2, 0),QD(-1,-1),QD(-1, 0),QD( 1, 2),QD( 1, 1),QD( 0, 2),QD( 0, 1),QD( 2, 2),QD( 2, 1),QD(-1, 2),QD(-1, 1),
+	/* 4 */ QD(-1, 0),QD(-1, 1),QD( 2, 0),QD( 2, 1),QD( 0, 0),QD( 0, 1),QD( 1, 0),QD( 1, 1),QD(-1,-1),QD(-1, 2),QD( 2,-1),QD( 2, 2),QD( 0,-1),QD( 0, 2),QD( 1,-1),QD( 1, 2),
+	/* 5 */ QD(-1,-1),QD(-1, 0),QD( 2,-1),QD( 2, 0),QD( 0,-1),QD( 0, 0),QD( 1,-1),QD( 1, 0),QD(-1, 2),QD(-1, 1),QD( 2, 2),QD( 2, 1),QD( 0, 2),QD( 0, 1),QD( 1, 2),QD( 1, 1),
+	/* 6 */ QD( 2, 0),QD( 2, 1),QD( 1, 0),QD( 1, 1),QD(-1, 0),QD(-1, 1),QD( 0, 0),QD( 0, 1),QD( 2,-1),QD( 2, 2),QD( 1,-1),QD( 1, 2),QD(-1,-1),QD(-1, 2),QD( 0,-1),QD( 0, 2),
+	/* 7 */ QD( 2,-1),QD( 2, 0),QD( 1,-1),QD( 1, 0),QD(-1,-1),QD(-1, 0),QD( 0,-1),QD( 0, 0),QD( 2, 2),QD( 2, 1),QD( 1, 2),QD( 1, 1),QD(-1, 2),QD(-1, 1),QD( 0, 2),QD( 0, 1),
+	/* 8 */ QD( 0, 1),QD( 0, 2),QD(-1, 1),QD(-1, 2),QD( 1, 1),QD( 1, 2),QD( 2, 1),QD( 2, 2),QD( 0, 0),QD( 0,-1),QD(-1, 0),QD(-1,-1),QD( 1, 0),QD( 1,-1),QD( 2, 0),QD( 2,-1),
+	/* 9 */ QD( 0, 2),QD( 0,-1),QD(-1, 2),QD(-1,-1),QD( 1, 2),QD( 1,-1),QD( 2, 2),QD( 2,-1),QD( 0, 1),QD( 0, 0),QD(-1, 1),QD(-1, 0),QD( 1, 1),QD( 1, 0),QD( 2, 1),QD( 2, 0),
+	/* A */ QD( 1, 1),QD( 1, 2),QD( 0, 1),QD( 0, 2),QD( 2, 1),QD( 2, 2),QD(-1, 1),QD(-1, 2),QD( 1, 0),QD( 1,-1),QD( 0, 0),QD( 0,-1),QD( 2, 0),QD( 2,-1),QD(-1, 0),QD(-1,-1),
+	/* B */ QD( 1, 2),QD( 1,-1),QD( 0, 2),QD( 0,-1),QD( 2, 2),QD( 2,-1),QD(-1, 2),QD(-1,-1),QD( 1, 1),QD( 1, 0),QD( 0, 1),QD( 0, 0),QD( 2, 1),QD( 2, 0),QD(-1, 1),QD(-1, 0),
+	/* C */ QD(-1, 1),QD(-1, 2),QD( 2, 1),QD( 2, 2),QD( 0, 1),QD( 0, 2),QD( 1, 1),QD( 1, 2),QD(-1, 0),QD(-1,-1),QD( 2, 0),QD( 2,-1),QD( 0, 0),QD( 0,-1),QD( 1, 0),QD( 1,-1),
+	/* D */ QD(-1, 2),QD(-1,-1),QD( 2, 2),QD( 2,-1),QD( 0, 2),QD( 0,-1),QD( 1, 2),QD( 1,-1),QD(-1, 1),QD(-1, 0),QD( 2, 1),QD( 2, 0),QD( 0, 1),QD( 0, 0),QD( 1, 1),QD( 1, 0),
+	/* E */ QD( 2, 1),QD( 2, 2),QD( 1, 1),QD( 1, 2),QD(-1, 1),QD(-1, 2),QD( 0, 1),QD( 0, 2),QD( 2, 0),QD( 2,-1),QD( 1, 0),QD( 1,-1),QD(-1, 0),QD(-1,-1),QD( 0, 0),QD( 0,-1),
+	/* F */ QD( 2, 2),QD( 2,-1),QD( 1, 2),QD( 1,-1),QD(-1, 2),QD(-1,-1),QD( 0, 2),QD( 0,-1),QD( 2, 1),QD( 2, 0),QD( 1, 1),QD( 1, 0),QD(-1, 1),QD(-1, 0),QD( 0, 1),QD( 0, 0),
+};
+
+#endif // _mousemap_h__
@@ -22,25 +22,41 @@
 #include <avr/io.h>
 #include <util/delay.h>
 #include <avr/pgmspace.h>
+#include <avr/interrupt.h>
 #include <string.h>
 #include "usbconfig.h"
 #include "vectrex.h"
-
-#define SETUPDELAY 100
+#include "potfilter.h"
 
 #define AXIS_X	0
 #define AXIS_Y	1
 
+/* The ADC runs by interrupt, alternating X and Y by itself. Each axis is
+ * oversampled 4^OVERSAMPLE_BITS times and decimated, giving 10+OVERSAMPLE_BITS
+ * bits. At ADC clock 12MHz/128 a 12 bits pair takes ~4.6mS (~220 Hz).
+ */
+#define OVERSAMPLE_BITS	2
+#define OVERSAMPLES		(1<<(2*OVERSAMPLE_BITS))
+#define AXIS_MAX		((1<<(10+OVERSAMPLE_BITS))-1)
+
+#define FILTER_BAND	(1<<OVERSAMPLE_BITS)	// One step of the plain 10 bits conversion
+
+#define ADMUX_X	(3 | (1<<REFS0))	// AREF=VCC
+#define ADMUX_Y	(4 | (1<<REFS0))
+
 static char VectrexInit(void);
 static void VectrexUpdate(void);
 static char VectrexChanged(char id);
 static char VectrexBuildReport(unsigned char *reportBuffer, char id);
-static void VectrexReadAxis(unsigned int);
 
-volatile unsigned char channel[2];
-volatile unsigned char old_channel[2];
-volatile int currentchannel;
-volatile char flag;
+volatile unsigned int channel[2];
+volatile unsigned int old_channel[2];
+static PotFilter filter[2];
+
+static volatile unsigned int adc_result[2];	// Latest decimated values, written by the ADC interrupt
+static unsigned int adc_sum;
+static unsigned char adc_count;
+static unsigned char adc_axis;
 
 static unsigned char button_state;
 static unsigned char button_reported_state;
@@ -73,21 +89,62 @@ static char VectrexInit(void)
 
 	old_channel[AXIS_X]=channel[AXIS_X]=0;
 	old_channel[AXIS_Y]=channel[AXIS_Y]=0;
+	potFilterInit(&filter[AXIS_X], 0, FILTER_BAND);
+	potFilterInit(&filter[AXIS_Y], 0, FILTER_BAND);
 
 	button_state=button_reported_state=0;
 
-	ADMUX |= ((1<<REFS0)|(1<<ADLAR));	// AREF=VCC ADLAR=1
-	ADCSRA |= (1<<ADEN);	// ADC enable
-	ADCSRA |= (1<<ADIF);	// Initialize for the first conversion
+	adc_result[AXIS_X]=adc_result[AXIS_Y]=0;
+	adc_sum=0;
+	adc_count=0;
+	adc_axis=AXIS_X;
+
+	DIDR0 |= ((1<<ADC3D)|(1<<ADC4D));	// No digital input on the wipers, less noise
+	ADMUX = ADMUX_X;
+	ADCSRA = (1<<ADEN)|(1<<ADIE)|(1<<ADIF)|(1<<ADPS2)|(1<<ADPS1)|(1<<ADPS0); // ADC enable, 12MHz/128 = 93.75KHz
+	ADCSRA |= (1<<ADSC);	// Start the first conversion
 
 	return 0;
 }
 
+ISR(ADC_vect)
+{
+	unsigned int value = ADC;
+
+	/* The first conversion after a channel switch is discarded */
+	if (adc_count++)
+		adc_sum += value;
+
+	if (adc_count > OVERSAMPLES)
+	{
+		adc_result[adc_axis] = adc_sum>>OVERSAMPLE_BITS;
+		adc_sum = 0;
+		adc_count = 0;
+		adc_axis ^= 1;
+		ADMUX = adc_axis ? ADMUX_Y : ADMUX_X;
+	}
+
+	ADCSRA |= (1<<ADSC);	// Next conversion
+}
+
 static void VectrexUpdate(void)
 {
+	unsigned int x,y;
+	unsigned char sreg;
+
 	button_state=~(PINB&0x0F); //Read all 4 buttons
-	VectrexReadAxis(AXIS_X); // Read x axis value
-	VectrexReadAxis(AXIS_Y); // Read y axis value	
+
+	// Latest decimated values, copied with interrupts masked. ADCSRA is
+	// not touched: writing it back could clear a pending ADIF, and the ADC
+	// interrupt is what starts the next conversion.
+	sreg=SREG;
+	cli();
+	x=adc_result[AXIS_X];
+	y=adc_result[AXIS_Y];
+	SREG=sreg;
+
+	channel[AXIS_X]=potFilter(&filter[AXIS_X], x);
+	channel[AXIS_Y]=potFilter(&filter[AXIS_Y], y);
 }
 
 static char VectrexChanged(char id)
@@ -95,15 +152,21 @@ static char VectrexChanged(char id)
 	return ((button_state != button_reported_state)||(old_channel[AXIS_X] != channel[AXIS_X])||(old_channel[AXIS_Y] != channel[AXIS_Y]));		
 }
 
-#define REPORT_SIZE 3
+#define REPORT_SIZE 5
 
 static char VectrexBuildReport(unsigned char *reportBuffer, char id)
 {
+	unsigned int y;
+
 	if (reportBuffer)
 	{
+		y=AXIS_MAX-channel[AXIS_Y];
+
 		reportBuffer[0]=button_state;
 		reportBuffer[1]=channel[AXIS_X];
-		reportBuffer[2]=255-channel[AXIS_Y];
+		reportBuffer[2]=channel[AXIS_X]>>8;
+		reportBuffer[3]=y;
+		reportBuffer[4]=y>>8;
 	}
 
 	button_reported_state=button_state;
@@ -131,8 +194,8 @@ const char Vectrex_usbHidReportDescriptor[] PROGMEM = {
     0x09, 0x30,                    //     USAGE (X)
     0x09, 0x31,                    //     USAGE (Y)
     0x15, 0x00,                    //     LOGICAL_MINIMUM (0)
-    0x26, 0xff, 0x00,              //     LOGICAL_MAXIMUM (255)
-    0x75, 0x08,                    //     REPORT_SIZE (8)
+    0x26, AXIS_MAX&0xff, AXIS_MAX>>8, //   LOGICAL_MAXIMUM (AXIS_MAX)
+    0x75, 0x10,                    //     REPORT_SIZE (16)
     0x95, 0x02,                    //     REPORT_COUNT (2)
     0x81, 0x02,                    //     INPUT (Data,Var,Abs)
 	0x09, 0x00,					   //     USAGE (Undefined) // Used to trig bootloader when SET FEATURE
@@ -184,21 +247,3 @@ Gamepad *VectrexGetGamepad(void)
 
 	return &VectrexJoy;
 }
-
-void VectrexReadAxis(unsigned int axis)
-{
-	flag=1;	// Read in process flag
-	currentchannel=axis; // Set current channel to be read
-
-	if(axis==AXIS_X)
-		ADMUX=3 | ((1<<REFS0)|(1<<ADLAR));
-	else
-		ADMUX=4 | ((1<<REFS0)|(1<<ADLAR));
-				
-	_delay_us(SETUPDELAY);	// Wait for level to stabilize
-
-	ADCSRA |= (1<<ADSC);	// Initialize the conversion
-	while(!(ADCSRA&(1<<ADIF)));	// Wait for conversion to complete
-	ADCSRA |= (1<<ADIF); // Initialize for the next conversion
-	channel[axis]=ADCH; // Read analog value
-}